@@ -6,214 +6,80 @@
 #include <queue>
 #include <sstream>
 #include <string>
-
-using namespace std;
-
-//define Huffman Tree
-//Huffman tree node is define by its character, frequency, left node, right node, left edge, and right edge
-struct HuffmanTreeNode
-{
-    char character;
-    int frequency;
-    HuffmanTreeNode* left;
-    HuffmanTreeNode* right;
-    string labelLeft;
-    string labelRigth;
-    
-    //initialize the Node
-    HuffmanTreeNode (char ch, int freq, string labelLeft, string labelRigth)
-    {
-        character=ch;
-        frequency=freq;
-        left=right=NULL;
-        labelRigth="";
-        labelLeft="";
-    }
-};
-
-//Implementation of Huffman Tree function class
-//Modify compare class for PQ
-class Compare{
-public: 
-    //Arrange the symbols based on their frequencies. If two or more symbols have the same frequency, they will be sorted based on their ASCII value.
-    //Insert internal node into the queue of nodes as the lowest node based on its frequency.
-    bool operator() (HuffmanTreeNode* first, HuffmanTreeNode* second)
-    {
-        if (first->frequency==second->frequency) 
-        {
-            if (first->character==second->character)
-            {
-                return first < second;//compare the order if frequency of internal node is equal
-            }
-            return (int)(first->character)>(int)(second->character); //compare ascii value if frequency is equal
-        }
-        return first->frequency > second->frequency; //compare frequency 
-    }
-};
-
-//initialize priority_queue
-priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> init_pq(char character[], int frequency[], int size, priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare>& pq)
-{
-    //initialize priority_queue
-    for (int i = 0; i < size; i++)
-    {
-        //initialize new HuffmanTree Node
-        HuffmanTreeNode* newNode = new HuffmanTreeNode(character[i], frequency[i],"","");
-        //push into priority_queue
-        pq.push(newNode);
-    }
-    return pq;
-}
-
-//Function to build Huffman Tree using PQ
-//when push into new node, label left edge as 1, right edge as 0.
-HuffmanTreeNode* buildHuffmanTree(priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq)
-{
-    //using while loop to generate the Tree
-    while (pq.size()>1)
-    {
-        //extract node with least frequency or ASCII value if equal
-        HuffmanTreeNode* left = pq.top();
-        //remove that node from priority_queue
-        pq.pop();
-
-        //extract node with second least frequency or ASCII if equal
-        HuffmanTreeNode* right = pq.top();
-        //remove that node from priority_queue
-        pq.pop();
-
-        //declare internal node which the value is the sum of its child frequency. Label left node as "0",right node as "1"
-        HuffmanTreeNode* i_node = new HuffmanTreeNode('\0', left->frequency+right->frequency,"0","1");
-        //build new branch of tree
-        i_node->left = left;
-        i_node->right = right;
-
-        //push internal node into our priority_queue
-        pq.push(i_node);
-    }
-    return pq.top(); //return the tree
-}
-
-//helper function to traverse tree to print binary code and store value in arr
-void traverse(HuffmanTreeNode* root, int arr[], int pos)
-{
-    //left traverse is 0, using recursion to achieve value
-    if (root->left)
-    {
-        arr[pos] = 0;
-        traverse(root->left, arr, pos+1);
-    }
-    
-    //right traverse is 1, using recursion to achieve value
-    if (root->right)
-    {
-        arr[pos]=1;
-        traverse(root->right,arr, pos+1);
-    }
-    
-    //print chararacter and its code when we reach leaf node
-    if (!root->left && !root->right)
-        {
-            //print binary code
-            std::cout<<"Symbol: "<<root->character<<", Frequency: "<<root->frequency<<", Code: ";
-            for (int i=0; i<pos; i++)
-            {
-                cout<<arr[i];
-            }
-            std::cout<<std::endl;
-        }
-}
-
-
-//print result from generating HuffmanTree
-void encode(HuffmanTreeNode* root)
-{
-    //traverse huffman tree and print result. Initiate empty array to store result
-    int arr[100], position=0;
-    traverse(root,arr,position);
-}
+#include <pthread.h>
+#include "../Assignment 3/huffmanTree.h"
+#include "../Assignment 3/huffmanTable.h"
+#include "../Assignment 3/huffmanFlatTree.h"
+#include "../Assignment 3/huffmanStream.h"
+#include "../Assignment 3/huffmanBlocks.h"
+#include "../Assignment 3/positionTable.h"
+#include "../Assignment 3/scatter.h"
+#include "../Assignment 3/inputLoader.h"
 
 //Define the thread arguments using to decompress the file
-//Include root, binaryCode, positions, and char to decompress
+//Include tree, binaryCode, and where to store the decoded char
 struct arguments
 {
-    HuffmanTreeNode* root;
-    string binaryCode;
-    vector<int> positions;
-    char* decompressedChars;
+    FlatHuffmanTree64* tree;
+    DecodeMode mode;
+    HuffmanDecodeTable* table;
+    const string* binaryCode; //points into binaryCodes, nothing is copied per thread
+    char* symbol;
 };
 
-//Helper function to traverse the Huffman tree and determine the character
-char getChar(HuffmanTreeNode* root, string binaryCode)
-{
-    HuffmanTreeNode* currentNode = root;
-    for (char c : binaryCode) {
-        if (c=='0') {
-            currentNode = currentNode->left;
-        } 
-        else 
-        {
-            currentNode = currentNode->right;
-        }
-    }
-    return currentNode->character;
-}
-
 //Thread function to decompress a symbol using void pointer arg
 void* decompress(void* arg)
 {
     arguments *args = (struct arguments*)arg;
 
     //Traverse the Huffman tree and get the character from the binary code
-    char ch = getChar(args->root, args->binaryCode);
+    char ch = decodeChar(args->mode, *args->tree, args->table, *args->binaryCode);
 
-    //Store the decompressed character
-    for (int pos : args->positions) {
-        args->decompressedChars[pos] = ch;
-    }
+    //Store the decompressed character, it is written to its positions once every thread is done
+    *args->symbol = ch;
     pthread_exit(NULL);
 }
 
 
 //Driver code
-int main()
-{   //initilze empty list of character and frequency
-    char character[100];
-    int frequency[100];
+int main(int argc, char* argv[])
+{   //initilze empty list of character and frequency, they grow with the alphabet
+    vector<char> character;
+    vector<uint64_t> frequency; //64 bit, a message can hold more than 2^31 characters
+    //select the tree walk or the table decoder
+    DecodeMode mode = parseDecodeMode(argc, argv);
 
     //Read input from filename.txt
-    int i=0;
-    int sum_freq=0;
+    uint64_t sum_freq=0;
     string filename;
     //input filename
     std::cin>>filename;
-    ifstream infile(filename);
-    if (!infile) {
+    InputBuffer alphabet; //the file is mapped and scanned in place
+    if (!alphabet.load(filename.c_str())) {
         cerr << "Error: could not open file" << endl;
         return 1;
     }
-    string line;
-    while (getline(infile, line)) {
-        character[i] = line[0];
-        frequency[i] = stoi(line.substr(2));
-        sum_freq+=frequency[i];
-        i++;
+    InputScanner scanner(alphabet.data(), alphabet.length());
+    while (!scanner.atEmptyLine()) {
+        character.push_back(scanner.readChar());
+        frequency.push_back(0);
+        scanner.readInt(frequency.back());
+        scanner.nextLine();
+        sum_freq+=frequency.back();
     }
-    infile.close(); //finish reading filename.
-    int size=i; //size of the arrays is equal to the number of elements
+    int size=character.size(); //size of the arrays is equal to the number of elements
 
-    //initialize priority_queue
-    priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq;
-    init_pq(character, frequency, size, pq);
-
-    //buildHuffmanTree
-    HuffmanTreeNode* root=buildHuffmanTree(pq);
+    //build the Huffman tree in one contiguous node array
+    FlatHuffmanTree64 tree;
+    buildFlatHuffmanTree(character.data(), frequency.data(), size, tree);
     //Output the huffman tree
-    encode(root);
+    encode(tree);
+    //derive the decode tables shared by every thread
+    HuffmanDecodeTable table=buildDecodeTable(tree);
 
     //read compressedfile
     vector<string> binaryCodes;
-    vector<vector<int>> positions;
+    PositionTable positions; //positions of every binary code, one after the other in one array
     string filename2;
     cin >> filename2;
     ifstream infile2(filename2);
@@ -222,33 +88,76 @@ int main()
         return 1;
     }
 
-    string line2;
-    while (getline(infile2, line2)) {
-        istringstream iss(line2);
-        string binaryCode;
-        iss >> binaryCode;
-
-        vector<int> pos;
-        int p;
-        while (iss >> p) {
-            pos.push_back(p);
+    //a packed container carries its own alphabet, a single payload is decoded sequentially and blocks on every core
+    if (isPackedStream(infile2)) {
+        infile2.close();
+        InputBuffer packed; //the file is mapped, the blocks are decoded in place
+        if (!packed.load(filename2.c_str())) {
+            cerr << "Error: could not open file" << endl;
+            return 1;
         }
+        MemoryStreamBuffer bytes(packed.data(), packed.length());
+        istream in(&bytes);
+        BitReader reader(in);
+        StreamHeader header;
+        if (!readStreamHeader(reader, header)) {
+            cerr << "Error: invalid compressed file" << endl;
+            return 1;
+        }
+        StreamCodec codec;
+        if (!prepareStreamCodec(header, codec)) {
+            cerr << "Error: unsupported code lengths" << endl;
+            return 1;
+        }
+        ThreadPool pool;
+        cout<<"Original message: ";
+        bool complete = decodeContainerTo(pool, reader, header, codec, mode, packed.data(), packed.length(), cout); //decoded and printed window by window
+        cout << endl;
+        if (!complete) {
+            cerr << "Error: truncated compressed file" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    infile2.close();
+    InputBuffer compressed; //the file is mapped and scanned in place
+    if (!compressed.load(filename2.c_str())) {
+        cerr << "Error: could not open file" << endl;
+        return 1;
+    }
+    InputScanner lines(compressed.data(), compressed.length());
+    positions.reserve(size, sum_freq);
+    while (!lines.atEnd() && (int)binaryCodes.size() < size) { //lines past the one of every symbol are ignored
+        string binaryCode;
+        lines.readToken(binaryCode);
+        lines.readInts(positions);
+        positions.endRow();
+        lines.nextLine();
         binaryCodes.push_back(binaryCode);
-        positions.push_back(pos);
     }
-    infile2.close(); //finish reading compressed file
+    if ((int)binaryCodes.size() < size) {
+        cerr << "Error: the compressed file has fewer lines than the alphabet" << endl;
+        return 1;
+    }
+    if (positions.tooLarge() > 0) {
+        cerr << "Error: positions beyond 4 GiB need a build with HUFFMAN_POSITIONS_64" << endl;
+        return 1;
+    }
     
     // Create the thread arguments and POSIX threads
     int nthreads=size; //initialize n threads which size equal to number of line
     pthread_t *tid = new pthread_t[nthreads]; //create m thread id
     arguments *args=new arguments[nthreads]; //create m arguments thread
-    char decompressedChars[sum_freq]; //initialize the message when we decompressed
+    vector<char> decompressedChars(sum_freq); //initialize the message when we decompressed, on the heap as it can be large
+    vector<char> symbols(nthreads); //decoded char of every binary code
     for (int i = 0; i < nthreads; i++) {
         //assign threads 
-        args[i].root = root;
-        args[i].binaryCode = binaryCodes[i];
-        args[i].positions = positions[i];
-        args[i].decompressedChars = decompressedChars;
+        args[i].tree = &tree;
+        args[i].mode = mode;
+        args[i].table = &table;
+        args[i].binaryCode = &binaryCodes[i];
+        args[i].symbol = &symbols[i];
         //Call pthread_create
         if (pthread_create(&tid[i], NULL, decompress, &args[i]))
         {
@@ -262,11 +171,13 @@ int main()
         pthread_join(tid[i], NULL);
     }
 
+    //Write every char to its positions, each cache line of the message is written by one thread
+    ThreadPool pool;
+    scatterPositions(pool, symbols, positions, decompressedChars.data(), sum_freq);
+
     // Print the original message
     cout<<"Original message: ";
-    for (int i=0;i<sum_freq;i++) {
-        cout<<decompressedChars[i];
-    }
+    cout.write(decompressedChars.data(), sum_freq);
     cout << endl;
     return 0;
 }
\ No newline at end of file
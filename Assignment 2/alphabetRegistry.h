@@ -0,0 +1,224 @@
+/*Named alphabets of the decode server and their publication to the server threads.
+The alphabets are held in an immutable AlphabetSet. Loading, changing or dropping an alphabet builds a new set and
+publishes it with one atomic pointer swap, so a server thread never waits for a reload and never sees half of one.
+Each server thread marks the epoch in which it reads the set in its own slot while it handles a batch of events; the
+previous set is freed once every thread has left the epochs in which it could still see it (read-copy-update with
+epoch based reclamation). Only the thread that publishes waits, the readers never do.*/
+#ifndef ALPHABETREGISTRY_H
+#define ALPHABETREGISTRY_H
+
+#include "huffmanTree.h"
+#include "protocol.h"
+#include "../Assignment 3/inputLoader.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+/*One alphabet with its Huffman Tree and decode tables, never changed once it is in a published set.*/
+struct ServerAlphabet
+{
+    std::string name;
+    uint32_t id; //alphabetId(name), 0 for the alphabet read from the standard input
+    FlatHuffmanTree tree; //Huffman Tree stored as a flat node array.
+    HuffmanDecodeTable table; //Decode tables derived from the Huffman Tree.
+    int64_t modified; //modification time of the alphabet file in ns, to reload only the files that changed
+    int64_t bytes; //size of the alphabet file
+};
+
+/*The alphabets served at one point in time, by id.*/
+struct AlphabetSet
+{
+    std::unordered_map<uint32_t, std::shared_ptr<const ServerAlphabet>> alphabets;
+
+    /*The alphabet with this id, NULL if the server does not have it*/
+    const ServerAlphabet *find(uint32_t id) const
+    {
+        auto it = alphabets.find(id);
+        return it == alphabets.end() ? NULL : it->second.get();
+    }
+};
+
+class AlphabetRegistry
+{
+public:
+    /*readers is the number of threads calling enter and leave, every one of them with its own index*/
+    AlphabetRegistry(int readers) : current(new AlphabetSet()), epoch(1), slots(readers)
+    {
+        for (ReaderSlot &slot : slots)
+        {
+            slot.epoch.store(IDLE);
+        }
+        pthread_mutex_init(&writer, NULL);
+    }
+
+    ~AlphabetRegistry()
+    {
+        delete current.load();
+        pthread_mutex_destroy(&writer);
+    }
+
+    AlphabetRegistry(const AlphabetRegistry &) = delete;
+    AlphabetRegistry &operator=(const AlphabetRegistry &) = delete;
+
+    /*Start reading the alphabets. The set returned stays valid until leave(reader), even if a new set is published
+    meanwhile. The epoch is marked before the set is read, so the publisher knows the reader may hold the set.*/
+    const AlphabetSet *enter(int reader)
+    {
+        slots[reader].epoch.store(epoch.load());
+        return current.load();
+    }
+
+    /*Stop reading, the set returned by enter may be freed from now on*/
+    void leave(int reader)
+    {
+        slots[reader].epoch.store(IDLE);
+    }
+
+    /*Publish a copy of the current set changed by change, then free the previous set after the grace period: every
+    reader that may hold it has left or entered again since the swap. Publishers are serialized, readers never wait.*/
+    void update(const std::function<void(AlphabetSet &)> &change)
+    {
+        pthread_mutex_lock(&writer);
+        AlphabetSet *next = new AlphabetSet(*current.load());
+        change(*next);
+        const AlphabetSet *previous = current.exchange(next);
+        uint64_t published = epoch.fetch_add(1) + 1;
+        for (ReaderSlot &slot : slots)
+        {
+            while (slot.epoch.load() < published)
+            {
+                sched_yield(); //the reader is still handling the events it took before the swap
+            }
+        }
+        delete previous;
+        pthread_mutex_unlock(&writer);
+    }
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX; //epoch of a reader that is not reading, later than any epoch
+
+    /*Epoch of one reader, on a cache line of its own so the readers do not slow each other down*/
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> epoch;
+    };
+
+    std::atomic<const AlphabetSet *> current;
+    std::atomic<uint64_t> epoch;
+    std::vector<ReaderSlot> slots;
+    pthread_mutex_t writer;
+};
+
+/*Read an alphabet in the format of the server's standard input: one symbol and its frequency per line, up to an
+empty line. Returns false if there is no symbol.*/
+bool parseAlphabet(const char *data, size_t length, std::vector<char> &symbols, std::vector<int> &frequencies)
+{
+    InputScanner scanner(data, length);
+    symbols.clear();
+    frequencies.clear();
+    while (!scanner.atEmptyLine())
+    {
+        char symbol = scanner.readChar();
+        int frequency = 0;
+        scanner.readInt(frequency);
+        scanner.nextLine();
+        symbols.push_back(symbol);
+        frequencies.push_back(frequency);
+    }
+    return !symbols.empty();
+}
+
+/*Build the Huffman Tree and the decode tables of an alphabet*/
+std::shared_ptr<ServerAlphabet> makeServerAlphabet(const std::string &name, uint32_t id, const std::vector<char> &symbols, const std::vector<int> &frequencies)
+{
+    std::shared_ptr<ServerAlphabet> alphabet(new ServerAlphabet());
+    alphabet->name = name;
+    alphabet->id = id;
+    buildFlatHuffmanTree(symbols.data(), frequencies.data(), symbols.size(), alphabet->tree);
+    alphabet->table = buildDecodeTable(alphabet->tree);
+    alphabet->modified = 0;
+    alphabet->bytes = 0;
+    return alphabet;
+}
+
+/*Bring set up to date with the alphabet files of directory: the file NAME or NAME.txt holds the alphabet NAME.
+Files that did not change keep their alphabet as it is, new and changed files are built again, and the alphabets
+whose file is gone are dropped. The alphabet of the standard input is always kept. Returns false if the directory
+cannot be read, set is then left as it is.*/
+bool scanAlphabetDirectory(const std::string &directory, AlphabetSet &set)
+{
+    DIR *dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        std::cerr << "ERROR opening the alphabet directory " << directory << std::endl;
+        return false;
+    }
+    std::unordered_map<uint32_t, std::shared_ptr<const ServerAlphabet>> next;
+    if (const ServerAlphabet *standard = set.find(0))
+    {
+        next[0] = set.alphabets[standard->id];
+    }
+    while (struct dirent *entry = readdir(dir))
+    {
+        std::string file = entry->d_name;
+        std::string path = directory + "/" + file;
+        struct stat info;
+        if (file[0] == '.' || stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            continue;
+        }
+        std::string name = file.size() > 4 && file.compare(file.size() - 4, 4, ".txt") == 0 ? file.substr(0, file.size() - 4) : file;
+        uint32_t id = alphabetId(name);
+        int64_t modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+        if (next.count(id))
+        {
+            std::cerr << "ERROR alphabet " << name << " has the id of alphabet " << next[id]->name << ", not loaded" << std::endl;
+            continue;
+        }
+
+        const ServerAlphabet *loaded = set.find(id);
+        if (loaded && loaded->name == name && loaded->modified == modified && loaded->bytes == (int64_t)info.st_size)
+        {
+            next[id] = set.alphabets[id]; //unchanged, shared with the previous set
+            continue;
+        }
+        InputBuffer input;
+        std::vector<char> symbols;
+        std::vector<int> frequencies;
+        if (!input.load(path.c_str()) || !parseAlphabet(input.data(), input.length(), symbols, frequencies))
+        {
+            std::cerr << "ERROR reading alphabet " << name << (loaded ? ", the previous one is kept" : "") << std::endl;
+            if (loaded && loaded->name == name)
+            {
+                next[id] = set.alphabets[id];
+            }
+            continue;
+        }
+        std::shared_ptr<ServerAlphabet> alphabet = makeServerAlphabet(name, id, symbols, frequencies);
+        alphabet->modified = modified;
+        alphabet->bytes = info.st_size;
+        next[id] = alphabet;
+        std::cerr << "Alphabet " << name << " loaded, id " << id << ", " << symbols.size() << " symbols" << std::endl;
+    }
+    closedir(dir);
+    for (const auto &loaded : set.alphabets)
+    {
+        if (!next.count(loaded.first))
+        {
+            std::cerr << "Alphabet " << loaded.second->name << " dropped" << std::endl;
+        }
+    }
+    set.alphabets.swap(next);
+    return true;
+}
+
+#endif
@@ -1,4 +1,9 @@
 #include "huffmanTree.h"
+#include "../Assignment 3/huffmanStream.h"
+#include "../Assignment 3/positionTable.h"
+#include "../Assignment 3/scatter.h"
+#include "huffmanClient.h"
+#include "../Assignment 3/inputLoader.h"
 #include <iostream>
 #include <unistd.h>
 #include <string.h>
@@ -11,103 +16,76 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
-#include <pthread.h>
+#include <iterator>
 
-/*the arguments struct is designed for multithread to hold data for the decompression task*/
-struct arguments
+/*Read the client settings from the command line: --connections=N, --timeout=MS, --retries=N and --alphabet=NAME.*/
+ClientOptions parseClientOptions(int argc, char *argv[])
 {
-    /*Receives the information about the symbol to decompress (binary code and list of positions) from the main thread.*/
-    string hostname; //server host name 
-    int port; //port number
-    string binaryCode; //binaryCode reads from STDIN
-    vector<int> positions; //list of positions read from STDIN
-    char *decompressedChars; //pointer to the decompressed string's memory location
-};
-
-
-/* The decompress function's task is connecting to the server, sending the binary code, have the server to convert it into 
-character, then receiving the decompressed character from the server, and updating the decompressed string according to 
-list of positions.*/
-void *decompress(void *arg)
-{
-    /*Cast the void pointer to arguments pointer.*/
-    arguments *args = (struct arguments *)arg;
-    
-    /*Variables use for create and connect socket.*/
-    int sockfd;  //the server socket file descriptor.
-    struct sockaddr_in serv_addr; //the server address's information.
-    struct hostent *server; //pointer to hostent struct that store information about the server's host.
-
-    /*Create a TCP socket to communicate with the server program.*/
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    /*Check if the socket creation was successful.*/
-    if (sockfd < 0)
+    ClientOptions options;
+    for (int i = 3; i < argc; i++)
     {
-        std::cerr << "ERROR opening socket" << std::endl;
-        pthread_exit(NULL);
-    }
-    
-    /*Resolve server's hostname.*/
-    server = gethostbyname(args->hostname.c_str());
-    /*Check if hosting is succesful.*/
-    if (server == NULL)
-    {
-        std::cerr << "ERROR no such host" << std::endl;
-        exit(0);
-    }
-
-    /*Initialize server address structure.*/
-    bzero((char *)&serv_addr, sizeof(serv_addr)); //Clear the memory of the serv_addr structure.
-    serv_addr.sin_family = AF_INET;//indicating that the server will use IPv4 addresses.
-    bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length); //copies the first IP address associated with the resolved hostname into the server address structure.
-    serv_addr.sin_port = htons(args->port); //assigns the server's port number.
-
-    //Connect to the server
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
-    {
-        std::cerr << "ERROR connecting" << std::endl;
-        exit(1);
+        if (strncmp(argv[i], "--connections=", 14) == 0)
+        {
+            options.connections = atoi(argv[i] + 14);
+        }
+        else if (strncmp(argv[i], "--timeout=", 10) == 0)
+        {
+            options.timeoutMs = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--retries=", 10) == 0)
+        {
+            options.retries = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--alphabet=", 11) == 0)
+        {
+            options.alphabet = alphabetId(argv[i] + 11);
+        }
     }
+    return options;
+}
 
-    /*Send the binary code to the server using socket.*/
-    string binaryCode = args->binaryCode; //create local string binary code.
-    int binaryCodeSize = binaryCode.size()+1; //create the size of the binary code.
-    int n; //variable used to store the return value of the read() and write() functions.
-    n=write(sockfd, &binaryCodeSize, sizeof(int)); //writes the binaryCodeSize value to the socket to inform the server how many bytes will be sent for the binary code.
-    /*Check if writing size of binary code to sever is successful*/
-    if (n < 0) 
+/*Decode a packed container from STDIN in this process, in windows of bounded size.*/
+int decompressPackedLocal()
+{
+    BitReader reader(std::cin);
+    StreamHeader header;
+    if (!readStreamHeader(reader, header))
     {
-        std::cerr << "ERROR writing binaryCodeSize to socket" << std::endl;
-        pthread_exit(NULL);
+        std::cerr << "ERROR invalid compressed file" << std::endl;
+        return 1;
     }
-    n=write(sockfd, binaryCode.c_str(), binaryCodeSize);//writes binaryCode to the socket.
-    /*Check if writing binary code to sever is successful*/
-    if (n < 0) 
+    StreamCodec codec;
+    if (!prepareStreamCodec(header, codec))
     {
-        std::cerr << "ERROR writing binaryCodeSize to socket" << std::endl;
-        pthread_exit(NULL);
+        std::cerr << "ERROR unsupported code lengths" << std::endl;
+        return 1;
     }
-
-    /*Wait for the decoded representation of the binary code (character) from the server*/
-    char decodedChar; 
-    n=read(sockfd, &decodedChar, sizeof(char)); //Receive the decode character from the server.
-    /*Check if receive the character from the sever is succesful*/
-    if (n < 0)
+    std::cout << "Original message: ";
+    bool complete = decodeStreamTo(reader, codec, DECODE_TABLE, std::cout, header.messageLength); //decoded and printed window by window
+    std::cout << std::endl;
+    if (!complete)
     {
-        std::cerr << "ERROR reading decoded character from socket" << std::endl;
-        pthread_exit(NULL);
+        std::cerr << "ERROR truncated compressed file" << std::endl;
+        return 1;
     }
+    return 0;
+}
 
-    /*Write the received information into a memory location accessible by the main thread.*/
-    for (int pos : args->positions)
+/*Send the packed container from STDIN to the server in one FRAME_DECODE_STREAM request and print the message it
+sends back.*/
+int decompressPackedRemote(HuffmanClient &client)
+{
+    std::string container((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+    std::string message;
+    if (!client.decodeMessage(container, message))
     {
-        args->decompressedChars[pos] = decodedChar;
+        std::cerr << "ERROR " << client.lastError() << std::endl;
+        return 1;
     }
-
-    // Close the socket
-    close(sockfd);
-
-    return NULL;
+    std::cout << "Original message: ";
+    std::cout.write(message.data(), message.size());
+    std::cout << std::endl;
+    return 0;
 }
 
 int main(int argc, char *argv[])
@@ -119,63 +97,77 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
-    /*Receive user input from STDIN*/
-    std::string line; //Initiate the number of line.
+    /*A packed container is shipped to the server whole and the server sends back the message, --local decodes it
+    here instead. Either way there are no per-symbol requests.*/
+    if (isPackedStream(std::cin))
+    {
+        bool local = false;
+        for (int i = 3; i < argc; i++)
+        {
+            local = local || strcmp(argv[i], "--local") == 0;
+        }
+        if (local)
+        {
+            return decompressPackedLocal();
+        }
+    }
+
+    /*Resolve the server once, every request goes through the connection pool of the client.*/
+    HuffmanClient client(parseClientOptions(argc, argv));
+    if (!client.resolve(argv[1], argv[2]))
+    {
+        std::cerr << "ERROR " << client.lastError() << std::endl;
+        return 1;
+    }
+    if (isPackedStream(std::cin))
+    {
+        return decompressPackedRemote(client);
+    }
+
+    /*Receive user input from STDIN, mapped or read in large blocks and scanned in place*/
+    InputBuffer input;
+    if (!input.load(stdin))
+    {
+        std::cerr << "ERROR reading the compressed file" << std::endl;
+        return 1;
+    }
+    InputScanner scanner(input.data(), input.length());
     std::vector<std::string> binaryCodes; //Initiate an empty array of binaryCodes.
-    std::vector<std::vector<int>> positions; //Initiate an empty 2D array of positions.
+    PositionTable positions; //Positions of every binary code, one list after the other in one array.
 
     /*Start reading input from compressed files*/
-    while (std::getline(std::cin, line)) {
-        std::istringstream iss(line);
+    while (!scanner.atEnd()) {
         std::string binaryCode;
-        iss >> binaryCode;
+        scanner.readToken(binaryCode);
 
-        std::vector<int> pos;
-        int p;
-        while (iss >> p) {
-            pos.push_back(p);
-        }
+        scanner.readInts(positions);
+        positions.endRow();
+        scanner.nextLine();
 
         binaryCodes.push_back(binaryCode);
-        positions.push_back(pos);
     }
-
-    int m = binaryCodes.size(); //Assign m to the number of line for the use of POSIX threads.
-    
-    /*The size of the decompressed file, calculated by finding the maximum position value to calculate decompressed size.*/
-    int decompressedSize = 0;
-    for (const auto &pos : positions)
+    if (positions.tooLarge() > 0)
     {
-        int maxPos = *max_element(pos.begin(), pos.end());
-        decompressedSize = max(decompressedSize, maxPos + 1);
+        std::cerr << "ERROR positions beyond 4 GiB need a build with HUFFMAN_POSITIONS_64" << std::endl;
+        return 1;
     }
 
+    /*The size of the decompressed file is the maximum position value + 1.*/
+    size_t decompressedSize = positions.messageSize();
+
     std::string decompressedString(decompressedSize, '\0'); //Initiate a string to store the decompressed data and fill it with null characters.
-    std::vector<pthread_t> threads(m);//Initiate a vector to store the thread IDs for 'm' threads.
-    std::vector<arguments> argsList(m);//Initiate a vector to store the argument structures for 'm' threads.
 
-    /*Setting up arguments structure for each thread*/
-    for (int i = 0; i < m; ++i)
-    {
-        argsList[i].hostname = argv[1]; //Assign the hostname.
-        argsList[i].port = atoi(argv[2]); //Assign the port number.
-        argsList[i].binaryCode = binaryCodes[i]; //Asssign the binary code.
-        argsList[i].positions = positions[i]; //Assign the list of position.
-        argsList[i].decompressedChars = decompressedString.data(); //Set the pointer to the decompressed string's data.
-    
-        /*Create a new thread with the decompress function and pass the arguments for the current thread*/
-        if (pthread_create(&threads[i], NULL, decompress, (void *)&argsList[i]))
-        {
-            fprintf(stderr, "Error creating thread\n");
-			    return 1;
-        }
-    }
-    
-    /*Joins m threads together*/
-    for (int i = 0; i < m; ++i)
+    /*Have the server decode every binary code.*/
+    std::vector<char> symbols; //decoded character of each binary code.
+    if (!client.decodeCodes(binaryCodes, symbols))
     {
-        pthread_join(threads[i], NULL);
+        std::cerr << "ERROR " << client.lastError() << std::endl;
+        return 1;
     }
+
+    /*Write every decoded character to its list of positions, each cache line of the string is written by one thread*/
+    ThreadPool pool;
+    scatterPositions(pool, symbols, positions, decompressedString.data(), decompressedString.size());
         
     /*Output the message*/
     std::cout << "Original message: ";
@@ -0,0 +1,670 @@
+/*Event driven decode server.
+Every thread runs its own epoll loop over non-blocking sockets. With more than one thread each of them binds its own
+listening socket to the port with SO_REUSEPORT and the kernel spreads the connections between them. A connection
+stays open for as many requests as the client sends. The alphabets, each with its Huffman Tree and decode tables, are
+shared read-only through the AlphabetRegistry, which a reload replaces without stopping the threads.
+Both the legacy request (int length and one code) and the frames of protocol.h are served on the same port.*/
+#ifndef DECODESERVER_H
+#define DECODESERVER_H
+
+#include "huffmanTree.h"
+#include "protocol.h"
+#include "alphabetRegistry.h"
+#include "../Assignment 3/huffmanStream.h"
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/*Longest binary code accepted in a request, a longer length closes the connection.*/
+const int MAX_REQUEST_CODE = 1 << 16;
+
+/*Everything the server threads share, read-only once the threads are started.*/
+struct ServerContext
+{
+    AlphabetRegistry* alphabets; //Alphabets served, one reader slot per server thread.
+    DecodeMode mode; //Engine used to turn a binary code into its symbol.
+    int port; //Port number every thread listens on.
+    std::string alphabetDirectory; //Alphabet files loaded again on SIGHUP, empty for none.
+};
+
+/*Decoded messages at least this large are written to a memory file and sent with sendfile instead of being copied
+into the reply buffer.*/
+const uint64_t ZERO_COPY_MIN = 256 * 1024;
+
+/*Part of the replies held in a memory file, sent once out has been sent up to position.*/
+struct OutputFile
+{
+    size_t position; //bytes of out that come before the file
+    int fd;
+    off_t offset; //next byte of the file to send
+    size_t remaining;
+};
+
+/*State of one client connection: the bytes received but not handled yet and the replies not sent yet.*/
+struct Connection
+{
+    int fd;
+    std::string in; //received bytes, requests are handled from inStart
+    size_t inStart;
+    std::string out; //replies, sent from outStart
+    size_t outStart;
+    std::deque<OutputFile> files; //replies sent from files, in the order of their positions in out
+    bool writing; //EPOLLOUT is registered because the replies could not be sent at once
+};
+
+/*Close the socket of conn and the files of the replies it did not send*/
+void closeConnection(Connection &conn)
+{
+    for (OutputFile &file : conn.files)
+    {
+        close(file.fd);
+    }
+    close(conn.fd); //also removes fd from the epoll set.
+}
+
+/*Read the number of server threads from the command line: --threads=N, 1 by default.*/
+int parseThreadCount(int argc, char *argv[])
+{
+    int threads = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            threads = atoi(argv[i] + 10);
+        }
+    }
+    return threads > 0 ? threads : 1;
+}
+
+/*Read the directory of named alphabets from the command line: --alphabets=DIR, none by default.*/
+std::string parseAlphabetDirectory(int argc, char *argv[])
+{
+    std::string directory;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--alphabets=", 12) == 0)
+        {
+            directory = argv[i] + 12;
+        }
+    }
+    return directory;
+}
+
+/*Create a non-blocking listening socket on port. reusePort lets several threads bind the same port.*/
+int openListener(int port, bool reusePort)
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0)
+    {
+        std::cerr << "ERROR opening socket" << std::endl;
+        return -1;
+    }
+    int on = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+    {
+        std::cerr << "ERROR setting SO_REUSEPORT" << std::endl;
+        close(sockfd);
+        return -1;
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET; //indicating that the server will use IPv4 addresses.
+    serv_addr.sin_addr.s_addr = INADDR_ANY; //bind to all available interfaces on the machine.
+    serv_addr.sin_port = htons(port);
+    if (bind(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    {
+        std::cerr << "ERROR on binding" << std::endl;
+        close(sockfd);
+        return -1;
+    }
+    listen(sockfd, SOMAXCONN);
+    return sockfd;
+}
+
+/*Set the payload length of the answer whose header starts at position start of out, once the payload follows it*/
+void patchAnswerLength(std::string &out, size_t start)
+{
+    uint32_t length = out.size() - start - FRAME_HEADER_SIZE;
+    for (int i = 0; i < 4; i++)
+    {
+        out[start + 12 + i] = (char)((length >> (8 * i)) & 0xff);
+    }
+}
+
+/*Answer a frame that could not be handled with an empty payload and the error status*/
+void answerError(std::string &out, const FrameHeader &request, uint8_t status)
+{
+    FrameHeader answer = {PROTOCOL_VERSION, (uint8_t)(request.type | 0x80), status, 0, request.requestId, 0};
+    writeFrameHeader(out, answer);
+}
+
+/*Decode the batch of codes of a FRAME_DECODE_CODES request into one FRAME_CODES_RESULT answer*/
+void handleDecodeCodes(const ServerContext &ctx, const ServerAlphabet &alphabet, const FrameHeader &request, const char *payload, std::string &out)
+{
+    const char *end = payload + request.length;
+    if (request.length < 4)
+    {
+        answerError(out, request, STATUS_BAD_REQUEST);
+        return;
+    }
+    uint32_t count = getU32(payload);
+    const char *p = payload + 4;
+
+    size_t start = out.size();
+    FrameHeader answer = {PROTOCOL_VERSION, FRAME_CODES_RESULT, STATUS_OK, 0, request.requestId, 0};
+    writeFrameHeader(out, answer);
+    putU32(out, count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (end - p < 2 || (size_t)(end - p - 2) < (getU16(p) + 7u) / 8)
+        {
+            //the batch is cut short, drop the partial answer
+            out.resize(start);
+            answerError(out, request, STATUS_BAD_REQUEST);
+            return;
+        }
+        size_t length = getU16(p);
+        out += decodeCharPacked(ctx.mode, alphabet.tree, &alphabet.table, (const unsigned char *)p + 2, length);
+        p += 2 + (length + 7) / 8;
+    }
+    patchAnswerLength(out, start);
+}
+
+/*Decode the message of a FRAME_DECODE_STREAM request into one FRAME_STREAM_RESULT answer.
+Large messages are decoded straight into a memory file that is then sent with sendfile, the decoded bytes are never
+copied into the reply buffer or through a user space send buffer.*/
+void handleDecodeStream(const ServerContext &ctx, const ServerAlphabet &alphabet, const FrameHeader &request, const char *payload, Connection &conn)
+{
+    MemoryStreamBuffer buffer(payload, request.length);
+    std::istream in(&buffer);
+    BitReader reader(in);
+
+    //the container carries its own alphabet, otherwise the codes are those of the alphabet of the request
+    bool container = request.length >= 4 && memcmp(payload, HUFFMAN_STREAM_MAGIC, 4) == 0;
+    StreamHeader header;
+    StreamCodec codec;
+    uint64_t length;
+    if (container)
+    {
+        if (!readStreamHeader(reader, header) || !prepareStreamCodec(header, codec))
+        {
+            answerError(conn.out, request, STATUS_BAD_REQUEST);
+            return;
+        }
+        length = header.messageLength;
+    }
+    else if (!reader.readVarint(length))
+    {
+        answerError(conn.out, request, STATUS_BAD_REQUEST);
+        return;
+    }
+    /*every symbol takes at least the shortest code, so a message longer than the payload bits can hold is refused
+    before anything is allocated or decoded*/
+    int shortest = shortestCodeLength(container ? codec.table : alphabet.table);
+    uint64_t payloadBits = (uint64_t)(request.length - reader.offset()) * 8;
+    if (length > MAX_STREAM_MESSAGE || (shortest > 0 && length > payloadBits / shortest))
+    {
+        answerError(conn.out, request, STATUS_BAD_REQUEST);
+        return;
+    }
+
+    //false if the payload is shorter than its message
+    auto decode = [&](char *out) {
+        if (container)
+        {
+            decodeStream(reader, codec, ctx.mode, out, length);
+        }
+        else if (ctx.mode == DECODE_TABLE)
+        {
+            decodePayload(reader, alphabet.table, out, length);
+        }
+        else
+        {
+            decodePayloadTree(reader, alphabet.tree, out, length);
+        }
+        return !reader.overran();
+    };
+
+    size_t answerStart = conn.out.size();
+    FrameHeader answer = {PROTOCOL_VERSION, FRAME_STREAM_RESULT, STATUS_OK, 0, request.requestId, (uint32_t)length};
+    writeFrameHeader(conn.out, answer);
+    if (length >= ZERO_COPY_MIN)
+    {
+        int fd = memfd_create("huffman-message", 0);
+        void *file = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd, length) == 0)
+        {
+            file = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (file != MAP_FAILED)
+        {
+            bool complete = decode((char *)file);
+            munmap(file, length);
+            if (!complete)
+            {
+                close(fd);
+                conn.out.resize(answerStart);
+                answerError(conn.out, request, STATUS_BAD_REQUEST);
+                return;
+            }
+            conn.files.push_back({conn.out.size(), fd, 0, (size_t)length});
+            return;
+        }
+        if (fd >= 0)
+        {
+            close(fd); //no memory file, fall back to the reply buffer
+        }
+    }
+    size_t start = conn.out.size();
+    conn.out.resize(start + length);
+    if (!decode(&conn.out[start]))
+    {
+        conn.out.resize(answerStart);
+        answerError(conn.out, request, STATUS_BAD_REQUEST);
+    }
+}
+
+/*Handle one complete frame and append its answer to the replies of conn. The alphabet of the request is looked up
+in alphabets, the set the thread is reading.*/
+void handleFrame(const ServerContext &ctx, const AlphabetSet &alphabets, const FrameHeader &request, const char *payload, Connection &conn)
+{
+    std::string &out = conn.out;
+    if (request.version != PROTOCOL_VERSION)
+    {
+        answerError(out, request, STATUS_UNSUPPORTED);
+        return;
+    }
+    if (request.type != FRAME_DECODE_CODES && request.type != FRAME_DECODE_STREAM)
+    {
+        answerError(out, request, STATUS_UNSUPPORTED);
+        return;
+    }
+
+    //the alphabet id comes before the payload of the request
+    FrameHeader body = request;
+    uint32_t id = 0;
+    if (request.flags & FRAME_FLAG_ALPHABET)
+    {
+        if (request.length < 4)
+        {
+            answerError(out, request, STATUS_BAD_REQUEST);
+            return;
+        }
+        id = getU32(payload);
+        payload += 4;
+        body.length -= 4;
+    }
+    const ServerAlphabet *alphabet = alphabets.find(id);
+    if (!alphabet)
+    {
+        answerError(out, request, STATUS_UNKNOWN_ALPHABET);
+        return;
+    }
+
+    switch (request.type)
+    {
+    case FRAME_DECODE_CODES:
+        handleDecodeCodes(ctx, *alphabet, body, payload, out);
+        break;
+    case FRAME_DECODE_STREAM:
+        handleDecodeStream(ctx, *alphabet, body, payload, conn);
+        break;
+    default:
+        answerError(out, request, STATUS_UNSUPPORTED);
+        break;
+    }
+}
+
+/*Handle every complete request in the input of conn and append the replies to its output.
+A legacy request is an int length followed by that many bytes holding the binary code and a null character, the
+reply is the decoded character, in the alphabet read at startup. A frame is answered by a frame. Returns false if the
+connection sent something that is not a request.*/
+bool handleRequests(const ServerContext &ctx, const AlphabetSet &alphabets, Connection &conn)
+{
+    while (conn.in.size() - conn.inStart >= sizeof(int))
+    {
+        size_t available = conn.in.size() - conn.inStart;
+        const char *request = conn.in.data() + conn.inStart;
+        if (isFrameStart(request))
+        {
+            FrameHeader header;
+            if (available < FRAME_HEADER_SIZE)
+            {
+                break; //wait for the rest of the header
+            }
+            readFrameHeader(request, header);
+            if (header.length > MAX_FRAME_PAYLOAD)
+            {
+                return false;
+            }
+            if (available - FRAME_HEADER_SIZE < header.length)
+            {
+                break; //wait for the rest of the payload
+            }
+            handleFrame(ctx, alphabets, header, request + FRAME_HEADER_SIZE, conn);
+            conn.inStart += FRAME_HEADER_SIZE + header.length;
+            continue;
+        }
+
+        int binary_code_length;
+        memcpy(&binary_code_length, conn.in.data() + conn.inStart, sizeof(int));
+        const ServerAlphabet *standard = alphabets.find(0);
+        if (binary_code_length <= 0 || binary_code_length > MAX_REQUEST_CODE || !standard)
+        {
+            return false;
+        }
+        if (conn.in.size() - conn.inStart - sizeof(int) < (size_t)binary_code_length)
+        {
+            break; //wait for the rest of the code
+        }
+        const char *code = conn.in.data() + conn.inStart + sizeof(int);
+        std::string binary_code(code, strnlen(code, binary_code_length)); //the code ends at the null character.
+        conn.out += decodeChar(ctx.mode, standard->tree, &standard->table, binary_code);
+        conn.inStart += sizeof(int) + binary_code_length;
+    }
+
+    //drop the handled bytes once they are the larger part of the buffer
+    if (conn.inStart > 0 && conn.inStart * 2 >= conn.in.size())
+    {
+        conn.in.erase(0, conn.inStart);
+        conn.inStart = 0;
+    }
+    return true;
+}
+
+/*Send as much of the replies of conn as the socket takes, the bytes of out and the files in order.
+Returns false if the connection is broken.*/
+bool flushReplies(Connection &conn)
+{
+    while (true)
+    {
+        size_t boundary = conn.files.empty() ? conn.out.size() : conn.files.front().position;
+        ssize_t n;
+        if (conn.outStart < boundary)
+        {
+            n = send(conn.fd, conn.out.data() + conn.outStart, boundary - conn.outStart, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                conn.outStart += n;
+            }
+        }
+        else if (!conn.files.empty())
+        {
+            OutputFile &file = conn.files.front();
+            n = sendfile(conn.fd, file.fd, &file.offset, file.remaining);
+            if (n > 0 && (file.remaining -= n) == 0)
+            {
+                close(file.fd);
+                conn.files.pop_front();
+            }
+        }
+        else
+        {
+            break;
+        }
+        if (n == 0)
+        {
+            return false; //nothing could be sent although the socket was writable
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+    conn.out.clear();
+    conn.outStart = 0;
+    return true;
+}
+
+/*Register EPOLLOUT while replies are pending and remove it once they are sent.*/
+void updateInterest(int epfd, Connection &conn)
+{
+    bool pending = conn.outStart < conn.out.size() || !conn.files.empty();
+    if (pending != conn.writing)
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN | (pending ? (uint32_t)EPOLLOUT : 0);
+        event.data.fd = conn.fd;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &event);
+        conn.writing = pending;
+    }
+}
+
+/*Read what is available on conn, handle the requests and send the replies. Returns false to close conn.*/
+bool serveConnection(const ServerContext &ctx, const AlphabetSet &alphabets, int epfd, Connection &conn)
+{
+    char buffer[64 * 1024];
+    while (true)
+    {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            conn.in.append(buffer, n);
+            if ((size_t)n < sizeof(buffer))
+            {
+                break;
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            return false; //the client closed the connection
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        return false;
+    }
+    if (!handleRequests(ctx, alphabets, conn) || !flushReplies(conn))
+    {
+        return false;
+    }
+    updateInterest(epfd, conn);
+    return true;
+}
+
+/*Accept every pending connection on the listening socket and add it to the epoll set.*/
+void acceptConnections(int listenfd, int epfd, std::unordered_map<int, Connection> &connections)
+{
+    while (true)
+    {
+        int fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                std::cerr << "ERROR on accept" << std::endl;
+            }
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); //replies are small, do not hold them back.
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        Connection &conn = connections[fd];
+        conn.fd = fd;
+        conn.inStart = 0;
+        conn.outStart = 0;
+        conn.writing = false;
+    }
+}
+
+/*Event loop of one server thread on its own listening socket. reader is the slot of the thread in the registry, the
+thread reads the alphabets while it handles the events of one wait, never while it waits.*/
+int serveLoop(const ServerContext &ctx, int listenfd, int reader)
+{
+    int epfd = epoll_create1(0);
+    if (epfd < 0)
+    {
+        std::cerr << "ERROR creating epoll instance" << std::endl;
+        return 1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listenfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &event);
+
+    std::unordered_map<int, Connection> connections;
+    std::vector<struct epoll_event> events(256);
+    while (true)
+    {
+        int ready = epoll_wait(epfd, events.data(), events.size(), -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "ERROR waiting for events" << std::endl;
+            return 1;
+        }
+        const AlphabetSet *alphabets = ctx.alphabets->enter(reader);
+        for (int i = 0; i < ready; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listenfd)
+            {
+                acceptConnections(listenfd, epfd, connections);
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end())
+            {
+                continue;
+            }
+            Connection &conn = it->second;
+            bool open = !(events[i].events & EPOLLERR);
+            if (open && (events[i].events & EPOLLOUT))
+            {
+                open = flushReplies(conn);
+                if (open)
+                {
+                    updateInterest(epfd, conn);
+                }
+            }
+            if (open && (events[i].events & (EPOLLIN | EPOLLHUP)))
+            {
+                open = serveConnection(ctx, *alphabets, epfd, conn);
+            }
+            if (!open)
+            {
+                closeConnection(conn);
+                connections.erase(it);
+            }
+        }
+        ctx.alphabets->leave(reader);
+    }
+}
+
+/*Arguments of a server thread.*/
+struct ServerThread
+{
+    const ServerContext *ctx;
+    int listenfd;
+    int reader; //slot of the thread in the alphabet registry
+};
+
+void *serverThread(void *arg)
+{
+    ServerThread *thread = (ServerThread *)arg;
+    serveLoop(*thread->ctx, thread->listenfd, thread->reader);
+    return NULL;
+}
+
+/*Load the alphabet directory again on every SIGHUP. The new alphabets are built on this thread and published at once,
+the server threads go on decoding with the previous set until they take their next events.*/
+void *reloadThread(void *arg)
+{
+    const ServerContext *ctx = (const ServerContext *)arg;
+    sigset_t hangup;
+    sigemptyset(&hangup);
+    sigaddset(&hangup, SIGHUP);
+    while (true)
+    {
+        int signal;
+        if (sigwait(&hangup, &signal) != 0)
+        {
+            continue;
+        }
+        ctx->alphabets->update([&](AlphabetSet &set) { scanAlphabetDirectory(ctx->alphabetDirectory, set); });
+    }
+    return NULL;
+}
+
+/*Run the server with threads event loops, the registry of ctx needs a reader slot for each. The calling thread runs
+the first one and does not return unless the server cannot be started. With an alphabet directory, SIGHUP reloads it.*/
+int runServer(const ServerContext &ctx, int threads)
+{
+    std::vector<ServerThread> args(threads);
+    for (int i = 0; i < threads; i++)
+    {
+        args[i].ctx = &ctx;
+        args[i].listenfd = openListener(ctx.port, threads > 1);
+        args[i].reader = i;
+        if (args[i].listenfd < 0)
+        {
+            return 1;
+        }
+    }
+    if (!ctx.alphabetDirectory.empty())
+    {
+        //SIGHUP is only taken by sigwait in the reload thread, every thread created from here on has it blocked
+        sigset_t hangup;
+        sigemptyset(&hangup);
+        sigaddset(&hangup, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &hangup, NULL);
+        pthread_t reloader;
+        if (pthread_create(&reloader, NULL, reloadThread, (void *)&ctx))
+        {
+            std::cerr << "Error creating thread" << std::endl;
+            return 1;
+        }
+    }
+    std::vector<pthread_t> tids(threads);
+    for (int i = 1; i < threads; i++)
+    {
+        if (pthread_create(&tids[i], NULL, serverThread, &args[i]))
+        {
+            std::cerr << "Error creating thread" << std::endl;
+            return 1;
+        }
+    }
+    return serveLoop(ctx, args[0].listenfd, 0);
+}
+
+#endif
@@ -0,0 +1,524 @@
+/*Client library for the decode server.
+The server address is resolved once. Requests are spread over a fixed number of persistent connections and driven by
+one epoll loop in the calling thread, so neither the number of threads nor the number of sockets grows with the
+alphabet. A request that is not answered within the timeout, or whose connection breaks, is sent again on a fresh
+connection up to a number of retries. Errors are reported to the caller, the library never ends the process.*/
+#ifndef HUFFMANCLIENT_H
+#define HUFFMANCLIENT_H
+
+#include "protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/*Number of codes sent in one request frame.*/
+const size_t BATCH_CODES = 4096;
+
+/*Fewest codes worth a frame of their own when the codes are spread over the connections.*/
+const size_t MIN_BATCH_CODES = 256;
+
+/*Payload bytes of a request that add one millisecond to its timeout. A large request takes longer to send and a
+whole message longer to decode, a fixed timeout would expire and have the server decode it again.*/
+const size_t TIMEOUT_BYTES_PER_MS = 8 * 1024;
+
+/*Largest answer payload accepted, a whole decoded message.*/
+const uint64_t MAX_ANSWER_PAYLOAD = MAX_STREAM_MESSAGE > MAX_FRAME_PAYLOAD ? MAX_STREAM_MESSAGE : MAX_FRAME_PAYLOAD;
+
+/*Settings of a HuffmanClient.*/
+struct ClientOptions
+{
+    int connections = 4; //size of the connection pool
+    int timeoutMs = 5000; //time a request may wait for its answer, plus 1 ms per TIMEOUT_BYTES_PER_MS of payload
+    int retries = 2; //times a request is sent again after a timeout or a broken connection
+    uint32_t alphabet = 0; //alphabetId of the alphabet the codes are in, 0 for the default alphabet of the server
+};
+
+/*One request frame and its answer.*/
+struct ClientRequest
+{
+    uint8_t type; //frame type of the request
+    std::string payload;
+    uint8_t status; //status of the answer
+    std::string answer; //payload of the answer
+};
+
+class HuffmanClient
+{
+public:
+    HuffmanClient(const ClientOptions &clientOptions = ClientOptions()) : options(clientOptions), resolved(false), epfd(-1)
+    {
+        options.connections = std::max(options.connections, 1);
+        pool.resize(options.connections);
+    }
+
+    ~HuffmanClient()
+    {
+        for (PoolConnection &conn : pool)
+        {
+            closeSocket(conn);
+        }
+        if (epfd >= 0)
+        {
+            close(epfd);
+        }
+    }
+
+    /*Resolve the server address, once for the whole pool. Returns false if the host is unknown.*/
+    bool resolve(const char *hostname, const char *port)
+    {
+        struct addrinfo hints, *servinfo;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(hostname, port, &hints, &servinfo) != 0)
+        {
+            error = "no such host";
+            return false;
+        }
+        memcpy(&address, servinfo->ai_addr, servinfo->ai_addrlen);
+        addressLength = servinfo->ai_addrlen;
+        family = servinfo->ai_family;
+        freeaddrinfo(servinfo);
+        resolved = true;
+        return true;
+    }
+
+    /*Why the last call failed*/
+    const std::string &lastError() const
+    {
+        return error;
+    }
+
+    /*Send every request and wait for all the answers. Returns false if a request could not be answered within its
+    retries, the answers received so far are kept.*/
+    bool exchange(std::vector<ClientRequest> &requests)
+    {
+        if (!resolved)
+        {
+            error = "server address not resolved";
+            return false;
+        }
+        if (epfd < 0 && (epfd = epoll_create1(0)) < 0)
+        {
+            error = "cannot create epoll instance";
+            return false;
+        }
+
+        //every request waits in the queue until it is written to a connection
+        std::vector<Pending> pending(requests.size());
+        std::vector<size_t> queue;
+        for (size_t i = requests.size(); i-- > 0;)
+        {
+            pending[i].attempts = 0;
+            queue.push_back(i);
+        }
+        size_t remaining = requests.size();
+        bool failed = false;
+        std::vector<struct epoll_event> events(options.connections);
+
+        while (remaining > 0 && !failed)
+        {
+            //hand the queued requests to the least loaded connections
+            while (!queue.empty())
+            {
+                size_t index = queue.back();
+                queue.pop_back();
+                if (pending[index].attempts > options.retries)
+                {
+                    error = "request not answered after " + std::to_string(options.retries) + " retries: " + error;
+                    failed = true;
+                    break;
+                }
+                int c = leastLoaded();
+                if (pool[c].fd < 0 && !openSocket(pool[c]))
+                {
+                    pending[index].attempts++; //counts as a failed attempt, try again
+                    queue.push_back(index);
+                    continue;
+                }
+                uint8_t flags = options.alphabet != 0 ? FRAME_FLAG_ALPHABET : 0;
+                FrameHeader header = {PROTOCOL_VERSION, requests[index].type, STATUS_OK, flags, (uint32_t)index, (uint32_t)requests[index].payload.size()};
+                if (options.alphabet != 0)
+                {
+                    header.length += 4;
+                }
+                writeFrameHeader(pool[c].out, header);
+                if (options.alphabet != 0)
+                {
+                    putU32(pool[c].out, options.alphabet);
+                }
+                pool[c].out += requests[index].payload;
+                pool[c].inFlight.push_back(index);
+                pending[index].attempts++;
+                long long timeoutMs = options.timeoutMs + (long long)(requests[index].payload.size() / TIMEOUT_BYTES_PER_MS);
+                pending[index].deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            }
+            if (failed)
+            {
+                break;
+            }
+            for (PoolConnection &conn : pool)
+            {
+                updateInterest(conn);
+            }
+
+            //wait until a socket is ready or the first deadline passes
+            Clock::time_point next = Clock::time_point::max();
+            for (const PoolConnection &conn : pool)
+            {
+                for (size_t index : conn.inFlight)
+                {
+                    next = std::min(next, pending[index].deadline);
+                }
+            }
+            int waitMs = next == Clock::time_point::max() ? -1 : (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count() + 1);
+            int ready = epoll_wait(epfd, events.data(), events.size(), waitMs);
+            if (ready < 0 && errno != EINTR)
+            {
+                error = "epoll_wait failed";
+                failed = true;
+                break;
+            }
+
+            for (int i = 0; i < ready; i++)
+            {
+                PoolConnection &conn = pool[events[i].data.u32];
+                if (conn.fd < 0)
+                {
+                    continue;
+                }
+                bool open = !(events[i].events & EPOLLERR);
+                error = open ? error : "connection error";
+                if (open && conn.connecting && (events[i].events & EPOLLOUT))
+                {
+                    int socketError = 0;
+                    socklen_t length = sizeof(socketError);
+                    getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &socketError, &length);
+                    open = socketError == 0;
+                    conn.connecting = !open;
+                    error = open ? error : std::string("connect failed: ") + strerror(socketError);
+                }
+                if (open && !conn.connecting && (events[i].events & EPOLLOUT))
+                {
+                    open = flush(conn);
+                }
+                if (open && (events[i].events & (EPOLLIN | EPOLLHUP)))
+                {
+                    open = receive(conn, requests, remaining);
+                }
+                if (!open)
+                {
+                    requeue(conn, queue);
+                }
+            }
+
+            //a connection with an expired request is closed, its answers can no longer be trusted to come
+            Clock::time_point now = Clock::now();
+            for (PoolConnection &conn : pool)
+            {
+                for (size_t index : conn.inFlight)
+                {
+                    if (pending[index].deadline <= now)
+                    {
+                        error = "request timed out";
+                        requeue(conn, queue);
+                        break;
+                    }
+                }
+            }
+        }
+        if (failed)
+        {
+            //answers to the abandoned requests may still arrive, do not reuse their connections
+            for (PoolConnection &conn : pool)
+            {
+                if (!conn.inFlight.empty())
+                {
+                    conn.inFlight.clear();
+                    closeSocket(conn);
+                }
+            }
+        }
+        return !failed;
+    }
+
+    /*Have the server decode every binary code, symbols[i] receives the character of binaryCodes[i].*/
+    bool decodeCodes(const std::vector<std::string> &binaryCodes, std::vector<char> &symbols)
+    {
+        //spread the codes over the connections, without making frames too small to be worth it
+        size_t perConnection = (binaryCodes.size() + options.connections - 1) / options.connections;
+        size_t batch = std::min(BATCH_CODES, std::max(MIN_BATCH_CODES, perConnection));
+        std::vector<ClientRequest> requests;
+        for (size_t first = 0; first < binaryCodes.size(); first += batch)
+        {
+            size_t last = std::min(first + batch, binaryCodes.size());
+            ClientRequest request = {FRAME_DECODE_CODES, "", STATUS_OK, ""};
+            putU32(request.payload, last - first);
+            for (size_t i = first; i < last; i++)
+            {
+                if (!appendFrameCode(request.payload, binaryCodes[i]))
+                {
+                    error = "binary code too long";
+                    return false;
+                }
+            }
+            requests.push_back(request);
+        }
+        if (!exchange(requests))
+        {
+            return false;
+        }
+
+        symbols.assign(binaryCodes.size(), '\0');
+        for (size_t r = 0; r < requests.size(); r++)
+        {
+            size_t first = r * batch;
+            size_t count = std::min(batch, binaryCodes.size() - first);
+            const std::string &answer = requests[r].answer;
+            if (requests[r].status == STATUS_UNKNOWN_ALPHABET)
+            {
+                error = "unknown alphabet";
+                return false;
+            }
+            if (requests[r].status != STATUS_OK || answer.size() != 4 + count || getU32(answer.data()) != count)
+            {
+                error = "server rejected the request";
+                return false;
+            }
+            memcpy(symbols.data() + first, answer.data() + 4, count);
+        }
+        return true;
+    }
+
+    /*Have the server decode a whole packed message (see FRAME_DECODE_STREAM), message receives the result.*/
+    bool decodeMessage(const std::string &packed, std::string &message)
+    {
+        if (packed.size() > MAX_FRAME_PAYLOAD - 4) //room for the alphabet id
+        {
+            error = "compressed file too large for one request";
+            return false;
+        }
+        std::vector<ClientRequest> requests(1);
+        requests[0] = {FRAME_DECODE_STREAM, packed, STATUS_OK, ""};
+        if (!exchange(requests))
+        {
+            return false;
+        }
+        if (requests[0].status == STATUS_UNKNOWN_ALPHABET)
+        {
+            error = "unknown alphabet";
+            return false;
+        }
+        if (requests[0].status != STATUS_OK)
+        {
+            error = "server rejected the compressed file";
+            return false;
+        }
+        message.swap(requests[0].answer);
+        return true;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    /*State of one pooled connection*/
+    struct PoolConnection
+    {
+        int fd = -1;
+        bool connecting = false; //non-blocking connect in progress
+        bool watchingOut = false; //EPOLLOUT is registered
+        std::string out; //frames not written yet, from outStart
+        size_t outStart = 0;
+        std::string in; //bytes of answers not complete yet
+        std::vector<size_t> inFlight; //requests written to this connection and not answered
+    };
+
+    /*Progress of one request*/
+    struct Pending
+    {
+        int attempts;
+        Clock::time_point deadline;
+    };
+
+    ClientOptions options;
+    bool resolved;
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    int family;
+    int epfd;
+    std::vector<PoolConnection> pool;
+    std::string error;
+
+    int leastLoaded() const
+    {
+        int best = 0;
+        for (int c = 1; c < (int)pool.size(); c++)
+        {
+            if (pool[c].inFlight.size() < pool[best].inFlight.size())
+            {
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    /*Start a non-blocking connect for conn. Returns false if the socket cannot be created.*/
+    bool openSocket(PoolConnection &conn)
+    {
+        conn.fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (conn.fd < 0)
+        {
+            error = "cannot open socket";
+            return false;
+        }
+        int on = 1;
+        setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if (connect(conn.fd, (struct sockaddr *)&address, addressLength) < 0 && errno != EINPROGRESS)
+        {
+            error = std::string("connect failed: ") + strerror(errno);
+            close(conn.fd);
+            conn.fd = -1;
+            return false;
+        }
+        conn.connecting = true;
+        conn.watchingOut = true;
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.u32 = &conn - pool.data();
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &event);
+        return true;
+    }
+
+    void closeSocket(PoolConnection &conn)
+    {
+        if (conn.fd >= 0)
+        {
+            close(conn.fd); //also removes fd from the epoll set.
+        }
+        conn.fd = -1;
+        conn.connecting = false;
+        conn.watchingOut = false;
+        conn.out.clear();
+        conn.outStart = 0;
+        conn.in.clear();
+    }
+
+    /*Close conn and queue its unanswered requests to be sent again*/
+    void requeue(PoolConnection &conn, std::vector<size_t> &queue)
+    {
+        for (size_t index : conn.inFlight)
+        {
+            queue.push_back(index);
+        }
+        conn.inFlight.clear();
+        closeSocket(conn);
+    }
+
+    /*Watch for EPOLLOUT only while conn is connecting or has frames to write*/
+    void updateInterest(PoolConnection &conn)
+    {
+        if (conn.fd < 0)
+        {
+            return;
+        }
+        bool want = conn.connecting || conn.outStart < conn.out.size();
+        if (want != conn.watchingOut)
+        {
+            struct epoll_event event;
+            event.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0);
+            event.data.u32 = &conn - pool.data();
+            epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &event);
+            conn.watchingOut = want;
+        }
+    }
+
+    /*Write as much of the frames of conn as the socket takes. Returns false if the connection is broken.*/
+    bool flush(PoolConnection &conn)
+    {
+        while (conn.outStart < conn.out.size())
+        {
+            ssize_t n = send(conn.fd, conn.out.data() + conn.outStart, conn.out.size() - conn.outStart, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    return true;
+                }
+                error = std::string("send failed: ") + strerror(errno);
+                return false;
+            }
+            conn.outStart += n;
+        }
+        conn.out.clear();
+        conn.outStart = 0;
+        return true;
+    }
+
+    /*Read the answers available on conn and complete their requests. Returns false if the connection is broken.*/
+    bool receive(PoolConnection &conn, std::vector<ClientRequest> &requests, size_t &remaining)
+    {
+        char buffer[64 * 1024];
+        while (true)
+        {
+            ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (n > 0)
+            {
+                conn.in.append(buffer, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            error = n == 0 ? "connection closed by the server" : std::string("recv failed: ") + strerror(errno);
+            return false;
+        }
+
+        size_t start = 0;
+        while (conn.in.size() - start >= FRAME_HEADER_SIZE)
+        {
+            FrameHeader header;
+            if (!readFrameHeader(conn.in.data() + start, header) || header.length > MAX_ANSWER_PAYLOAD)
+            {
+                error = "invalid answer from the server";
+                return false;
+            }
+            if (conn.in.size() - start - FRAME_HEADER_SIZE < header.length)
+            {
+                break;
+            }
+            auto it = std::find(conn.inFlight.begin(), conn.inFlight.end(), (size_t)header.requestId);
+            if (it == conn.inFlight.end() || (header.type & 0x7f) != requests[header.requestId].type)
+            {
+                error = "unexpected answer from the server";
+                return false;
+            }
+            conn.inFlight.erase(it);
+            requests[header.requestId].status = header.status;
+            requests[header.requestId].answer.assign(conn.in, start + FRAME_HEADER_SIZE, header.length);
+            remaining--;
+            start += FRAME_HEADER_SIZE + header.length;
+        }
+        conn.in.erase(0, start);
+        return true;
+    }
+};
+
+#endif
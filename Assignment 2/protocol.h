@@ -0,0 +1,186 @@
+/*Framed binary protocol between the client and the decode server.
+Every frame starts with a 16 byte header, all integers are little endian:
+    magic 'H' 'F' 'P' 0xF1 | version u8 | type u8 | status u8 | flags u8 | request id u32 | payload length u32
+Read as an int the magic is negative, so the server tells a frame apart from the int length of a legacy request.
+A request frame carries a batch of codes and is answered by one frame with the same request id, so a client can
+pipeline any number of frames on one connection and match the answers by id.
+A request with FRAME_FLAG_ALPHABET starts its payload with the alphabet id u32 of a named alphabet of the server,
+alphabetId(name), and the payload described below follows it. Without the flag the codes are those of the alphabet
+the server read at startup. An unknown id is answered with STATUS_UNKNOWN_ALPHABET.
+
+FRAME_DECODE_CODES payload: count u32, then count times: code length in bits u16, code bits packed MSB first.
+FRAME_CODES_RESULT payload: count u32, then count decoded symbols, one byte each, in request order.
+FRAME_DECODE_STREAM payload: either a whole packed container (huffmanStream.h), which carries its own alphabet, or
+a varint message length followed by the packed codes of the message in the alphabet of the request.
+FRAME_STREAM_RESULT payload: the decoded message.*/
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const unsigned char FRAME_MAGIC[4] = {'H', 'F', 'P', 0xF1};
+const uint8_t PROTOCOL_VERSION = 1;
+const size_t FRAME_HEADER_SIZE = 16;
+const uint32_t MAX_FRAME_PAYLOAD = 64u << 20; //larger frames are rejected and close the connection
+const int MAX_FRAME_CODE = 0xffff;           //longest code of a FRAME_DECODE_CODES request in bits
+const uint64_t MAX_STREAM_MESSAGE = 1u << 30; //longest message a FRAME_DECODE_STREAM request may decode to
+
+/*Frame types, an answer has the high bit set*/
+enum FrameType
+{
+    FRAME_DECODE_CODES = 0x01,
+    FRAME_DECODE_STREAM = 0x02,
+    FRAME_CODES_RESULT = 0x81,
+    FRAME_STREAM_RESULT = 0x82
+};
+
+/*Status of an answer*/
+enum FrameStatus
+{
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1,  //the payload does not match its type
+    STATUS_UNSUPPORTED = 2,  //unknown version or type
+    STATUS_UNKNOWN_ALPHABET = 3 //the server has no alphabet with the id of the request
+};
+
+/*Flags of a request*/
+enum FrameFlag
+{
+    FRAME_FLAG_ALPHABET = 0x01 //the payload starts with an alphabet id
+};
+
+struct FrameHeader
+{
+    uint8_t version;
+    uint8_t type;
+    uint8_t status;
+    uint8_t flags; //FrameFlag bits, 0 in an answer
+    uint32_t requestId;
+    uint32_t length; //payload bytes after the header
+};
+
+/*Id of the named alphabet of the server, FNV-1a of the name. 0 is the alphabet read at startup, no name has it.*/
+inline uint32_t alphabetId(const std::string &name)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash = (hash ^ (unsigned char)c) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+inline void putU16(std::string &out, uint16_t value)
+{
+    out += (char)(value & 0xff);
+    out += (char)(value >> 8);
+}
+
+inline void putU32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out += (char)((value >> (8 * i)) & 0xff);
+    }
+}
+
+inline uint16_t getU16(const char *p)
+{
+    return (uint16_t)((unsigned char)p[0] | ((unsigned char)p[1] << 8));
+}
+
+inline uint32_t getU32(const char *p)
+{
+    return (uint32_t)(unsigned char)p[0] | ((uint32_t)(unsigned char)p[1] << 8) | ((uint32_t)(unsigned char)p[2] << 16) | ((uint32_t)(unsigned char)p[3] << 24);
+}
+
+/*true if the bytes start with the frame magic, size has to be at least 4*/
+inline bool isFrameStart(const char *p)
+{
+    return memcmp(p, FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0;
+}
+
+/*Append a frame header to out*/
+void writeFrameHeader(std::string &out, const FrameHeader &header)
+{
+    out.append((const char *)FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    out += (char)header.version;
+    out += (char)header.type;
+    out += (char)header.status;
+    out += (char)header.flags;
+    putU32(out, header.requestId);
+    putU32(out, header.length);
+}
+
+/*Read the frame header at p, which holds FRAME_HEADER_SIZE bytes. Returns false if the magic is wrong.*/
+bool readFrameHeader(const char *p, FrameHeader &header)
+{
+    if (!isFrameStart(p))
+    {
+        return false;
+    }
+    header.version = p[4];
+    header.type = p[5];
+    header.status = p[6];
+    header.flags = p[7];
+    header.requestId = getU32(p + 8);
+    header.length = getU32(p + 12);
+    return true;
+}
+
+/*Append one code written as '0'/'1' characters to a FRAME_DECODE_CODES payload.
+Returns false if the code is longer than MAX_FRAME_CODE.*/
+bool appendFrameCode(std::string &payload, const std::string &binaryCode)
+{
+    if (binaryCode.size() > (size_t)MAX_FRAME_CODE)
+    {
+        return false;
+    }
+    putU16(payload, binaryCode.size());
+    unsigned char byte = 0;
+    for (size_t i = 0; i < binaryCode.size(); i++)
+    {
+        byte = (byte << 1) | (binaryCode[i] == '1');
+        if (i % 8 == 7)
+        {
+            payload += (char)byte;
+            byte = 0;
+        }
+    }
+    if (binaryCode.size() % 8)
+    {
+        payload += (char)(byte << (8 - binaryCode.size() % 8));
+    }
+    return true;
+}
+
+/*Build a whole FRAME_DECODE_CODES frame for codes[first, last) and append it to out*/
+bool appendDecodeCodesFrame(std::string &out, uint32_t requestId, const std::vector<std::string> &codes, size_t first, size_t last)
+{
+    std::string payload;
+    putU32(payload, last - first);
+    for (size_t i = first; i < last; i++)
+    {
+        if (!appendFrameCode(payload, codes[i]))
+        {
+            return false;
+        }
+    }
+    FrameHeader header = {PROTOCOL_VERSION, FRAME_DECODE_CODES, STATUS_OK, 0, requestId, (uint32_t)payload.size()};
+    writeFrameHeader(out, header);
+    out += payload;
+    return true;
+}
+
+/*Append a whole FRAME_DECODE_STREAM frame carrying payload to out*/
+void appendDecodeStreamFrame(std::string &out, uint32_t requestId, const std::string &payload)
+{
+    FrameHeader header = {PROTOCOL_VERSION, FRAME_DECODE_STREAM, STATUS_OK, 0, requestId, (uint32_t)payload.size()};
+    writeFrameHeader(out, header);
+    out += payload;
+}
+
+#endif
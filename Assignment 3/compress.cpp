@@ -0,0 +1,223 @@
+// Huffman compressor producing inputs for the decompressors.
+// Usage: ./compress [--text | [--canonical] [--max-length=N] [--blocks=K]] < message > compressed
+//   default         packed container (huffmanStream.h), read by assignment 1, assignment 3 and the client
+//   --canonical     packed container with canonical codes, decoded without building a tree
+//   --max-length=N  canonical codes of at most N bits (package-merge), the size cost is reported on stderr
+//   --blocks=K      packed container cut into K independently decodable blocks, decoded on several cores; more
+//                   blocks are used when K would make them longer than MAX_BLOCK_SYMBOLS
+//   --text          assignment 3 text format: alphabet, then one binary code and its positions per symbol
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "huffmanTree.h"
+#include "huffmanEncode.h"
+
+//Read the whole message from STDIN, it is needed twice (histogram, then encoding)
+std::vector<unsigned char> readAll(FILE* in)
+{
+    std::vector<unsigned char> data;
+    size_t size = 0;
+    while (true)
+    {
+        data.resize(size + (1 << 20));
+        size_t n = fread(data.data() + size, 1, 1 << 20, in);
+        size += n;
+        if (n == 0)
+        {
+            break;
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+//Write the assignment 3 text format, every symbol gets its code followed by the positions where it appears
+int writeText(const std::vector<char>& symbols, const std::vector<int>& frequencies, const HuffmanCodeTable& codes, const std::vector<unsigned char>& data)
+{
+    //bucket the positions of every symbol in one pass over the message
+    std::vector<std::vector<uint32_t>> positions(256);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        positions[data[i]].push_back(i);
+    }
+
+    std::string out = std::to_string(symbols.size()) + "\n";
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        out += symbols[i];
+        out += " " + std::to_string(frequencies[i]) + "\n";
+    }
+    char number[16];
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        const HuffmanCode& code = codes.codes[(unsigned char)symbols[i]];
+        for (int b = code.length - 1; b >= 0; b--)
+        {
+            out += (char)('0' + ((code.bits >> b) & 1));
+        }
+        for (uint32_t pos : positions[(unsigned char)symbols[i]])
+        {
+            char* end = std::to_chars(number, number + sizeof(number), pos).ptr;
+            out += ' ';
+            out.append(number, end);
+        }
+        out += '\n';
+        if (out.size() > (1 << 20))
+        {
+            std::cout.write(out.data(), out.size());
+            out.clear();
+        }
+    }
+    std::cout.write(out.data(), out.size());
+    return 0;
+}
+
+//Print what limiting the code lengths costs: payload size against the unlimited Huffman code lengths
+void reportLengthLimit(const std::vector<char>& symbols, const std::vector<int>& frequencies, const HuffmanCodeTable& codes, int maxLength)
+{
+    std::vector<int> lengths;
+    computeCodeLengths(symbols.data(), frequencies.data(), symbols.size(), lengths);
+    uint64_t total = 0;
+    uint64_t limitedBits = 0;
+    uint64_t huffmanBits = 0;
+    int huffmanMax = 0;
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        total += frequencies[i];
+        limitedBits += (uint64_t)frequencies[i] * codes.codes[(unsigned char)symbols[i]].length;
+        huffmanBits += (uint64_t)frequencies[i] * lengths[i];
+        huffmanMax = std::max(huffmanMax, lengths[i]);
+    }
+    fprintf(stderr, "max code length %d (Huffman %d): %.4f bits/symbol against %.4f, payload %+.3f%%\n", maxLength, huffmanMax,
+            (double)limitedBits / total, (double)huffmanBits / total, huffmanBits ? 100.0 * ((double)limitedBits - huffmanBits) / huffmanBits : 0.0);
+}
+
+// Driver code
+int main(int argc, char* argv[])
+{
+    bool text = false;
+    bool canonical = false;
+    int maxLength = 0;
+    long long blocks = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--blocks=", 9) == 0)
+        {
+            blocks = atoll(argv[i] + 9);
+        }
+        text = text || strcmp(argv[i], "--text") == 0;
+        canonical = canonical || strcmp(argv[i], "--canonical") == 0;
+        if (strncmp(argv[i], "--max-length=", 13) == 0)
+        {
+            maxLength = atoi(argv[i] + 13);
+            canonical = true; //only canonical codes can be length limited
+            if (maxLength < 1 || maxLength > MAX_CODE_LENGTH)
+            {
+                std::cerr << "Error: --max-length has to be 1 to " << MAX_CODE_LENGTH << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (text && canonical)
+    {
+        //the text format is decoded by walking the Huffman Tree, its codes have to be the tree codes
+        std::cerr << "Error: --canonical and --max-length are only available for the packed container" << std::endl;
+        return 1;
+    }
+    if (text && blocks > 0)
+    {
+        std::cerr << "Error: --blocks is only available for the packed container" << std::endl;
+        return 1;
+    }
+    std::ios::sync_with_stdio(false);
+
+    std::vector<unsigned char> data = readAll(stdin);
+    if (data.empty())
+    {
+        std::cerr << "Error: empty message" << std::endl;
+        return 1;
+    }
+    if (data.size() > 0x7fffffff)
+    {
+        //frequencies and their sums in the tree are int
+        std::cerr << "Error: message too large" << std::endl;
+        return 1;
+    }
+
+    // Count the frequency of every byte, the alphabet is every byte that appears, in byte order
+    uint64_t counts[256];
+    countFrequencies(data.data(), data.size(), counts);
+    std::vector<char> symbols;
+    std::vector<int> frequencies;
+    for (int s = 0; s < 256; s++)
+    {
+        if (counts[s] == 0)
+        {
+            continue;
+        }
+        if (text && s == '\n')
+        {
+            std::cerr << "Error: the text format cannot represent a newline symbol" << std::endl;
+            return 1;
+        }
+        symbols.push_back((char)s);
+        frequencies.push_back((int)counts[s]);
+    }
+
+    if (text && symbols.size() < 2)
+    {
+        std::cerr << "Error: the text format cannot represent the empty code of a single symbol" << std::endl;
+        return 1;
+    }
+
+    // Build HuffmanTree and the code of every symbol, or only the code lengths for canonical codes
+    HuffmanCodeTable codes;
+    bool built;
+    if (canonical)
+    {
+        built = buildCanonicalCodeTable(symbols.data(), frequencies.data(), symbols.size(), codes, maxLength);
+    }
+    else
+    {
+        FlatHuffmanTree tree;
+        buildFlatHuffmanTree(symbols.data(), frequencies.data(), symbols.size(), tree);
+        built = buildCodeTable(tree, codes);
+    }
+    if (!built && maxLength > 0)
+    {
+        std::cerr << "Error: " << symbols.size() << " symbols do not fit in codes of " << maxLength << " bits" << std::endl;
+        return 1;
+    }
+    if (!built)
+    {
+        std::cerr << "Error: code longer than 64 bits" << std::endl;
+        return 1;
+    }
+    if (maxLength > 0)
+    {
+        reportLengthLimit(symbols, frequencies, codes, maxLength);
+    }
+
+    if (text)
+    {
+        return writeText(symbols, frequencies, codes, data);
+    }
+
+    // Write the packed container, in blocks of the same number of symbols if asked to
+    if (blocks > 0)
+    {
+        uint64_t blockSymbols = (data.size() + blocks - 1) / blocks;
+        blockSymbols = blockSymbols < MAX_BLOCK_SYMBOLS ? blockSymbols : MAX_BLOCK_SYMBOLS;
+        writeBlockedStream(std::cout, symbols, frequencies, codes, data.data(), data.size(), blockSymbols, canonical ? STREAM_FLAG_CANONICAL : 0, maxLength);
+        return 0;
+    }
+    BitWriter writer(std::cout);
+    writeStreamHeader(writer, symbols, frequencies, data.size(), canonical ? STREAM_FLAG_CANONICAL : 0, maxLength);
+    encodePayload(writer, codes, data.data(), data.size());
+    writer.flush();
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Parallel decoding of blocked containers (STREAM_FLAG_BLOCKS).
+// A single payload is one long dependency chain: where a code starts depends on the length of every code before it.
+// A blocked container restarts the payload every blockSymbols symbols at a byte boundary and indexes the block
+// sizes in the header, so the blocks are decoded on every core of the pool, and every core decodes a few blocks
+// interleaved, one symbol of each in turn, so their independent chains overlap in the pipeline.
+#ifndef HUFFMANBLOCKS_H
+#define HUFFMANBLOCKS_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "huffmanStream.h"
+#include "threadPool.h"
+
+//number of blocks one core decodes together, each one an independent dependency chain
+const int INTERLEAVED_STREAMS = 4;
+
+//Bit reader over one block in memory, the next bit is the most significant one of buffer.
+//Reads past the end of the block give zero bits, like BitReader.
+struct MemoryBitReader
+{
+    const unsigned char* pos;
+    const unsigned char* end;
+    uint64_t buffer;
+    int count;
+
+    //top up buffer to at least 56 bits
+    void refill()
+    {
+        if (end - pos >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, pos, 8);
+            buffer |= __builtin_bswap64(word) >> count;
+            int bytes = (63 - count) >> 3;
+            pos += bytes;
+            count += bytes * 8;
+            return;
+        }
+        while (count <= 56)
+        {
+            buffer |= (uint64_t)(pos < end ? *pos++ : 0) << (56 - count);
+            count += 8;
+        }
+    }
+
+    char decode(const HuffmanDecodeTable& table)
+    {
+        int length;
+        char symbol = (char)decodeWindow(table, buffer, length);
+        buffer = length < 64 ? buffer << length : 0;
+        count -= length;
+        return symbol;
+    }
+};
+
+//Function to decode up to INTERLEAVED_STREAMS blocks with the decode tables, one symbol of every block in turn.
+//reader[k] reads the bytes of block k, symbols[k] is its number of symbols and out[k] where they go. The codes have to
+//fit in 56 bits, so one refill is enough for group symbols of every block.
+void decodeInterleaved(const HuffmanDecodeTable& table, int streams, MemoryBitReader reader[], const uint64_t symbols[], char* out[])
+{
+    uint64_t done = 0;
+    uint64_t common = symbols[0];
+    for (int k = 1; k < streams; k++)
+    {
+        common = symbols[k] < common ? symbols[k] : common;
+    }
+    uint64_t group = table.maxLength > 0 ? 56 / table.maxLength : 56;
+    while (done + group <= common)
+    {
+        for (int k = 0; k < streams; k++)
+        {
+            reader[k].refill();
+        }
+        for (uint64_t g = 0; g < group; g++)
+        {
+            for (int k = 0; k < streams; k++)
+            {
+                out[k][done + g] = reader[k].decode(table);
+            }
+        }
+        done += group;
+    }
+    //what the blocks hold beyond the common part, one block at a time
+    for (int k = 0; k < streams; k++)
+    {
+        for (uint64_t i = done; i < symbols[k]; i++)
+        {
+            reader[k].refill();
+            out[k][i] = reader[k].decode(table);
+        }
+    }
+}
+
+//Function to decode blocks [first, first + count) of a blocked container into out, which receives the symbols of
+//block first onwards. payload holds the bytes of every block, blockOffset the start of every block in it.
+void decodeBlockRange(ThreadPool& pool, const StreamHeader& header, const StreamCodec& codec, DecodeMode mode, const unsigned char* payload, const vector<uint64_t>& blockOffset, uint64_t first, uint64_t count, char* out)
+{
+    uint64_t groups = (count + INTERLEAVED_STREAMS - 1) / INTERLEAVED_STREAMS;
+    bool interleaved = mode == DECODE_TABLE && codec.table.maxLength <= 56;
+    pool.run(groups, [&](int group) {
+        MemoryBitReader reader[INTERLEAVED_STREAMS];
+        uint64_t symbols[INTERLEAVED_STREAMS];
+        char* target[INTERLEAVED_STREAMS];
+        int streams = 0;
+        for (uint64_t b = first + (uint64_t)group * INTERLEAVED_STREAMS; b < first + count && streams < INTERLEAVED_STREAMS; b++, streams++)
+        {
+            uint64_t start = b * header.blockSymbols;
+            symbols[streams] = header.messageLength - start < header.blockSymbols ? header.messageLength - start : header.blockSymbols;
+            target[streams] = out + (start - first * header.blockSymbols);
+            reader[streams] = {payload + blockOffset[b], payload + blockOffset[b + 1], 0, 0};
+        }
+        if (interleaved)
+        {
+            decodeInterleaved(codec.table, streams, reader, symbols, target);
+            return;
+        }
+        //the per bit engines keep the single payload decoders, one block after the other
+        for (int k = 0; k < streams; k++)
+        {
+            MemoryStreamBuffer bytes((const char*)reader[k].pos, reader[k].end - reader[k].pos);
+            istream in(&bytes);
+            BitReader bits(in);
+            decodeSingleStream(bits, codec, mode, target[k], symbols[k]);
+        }
+    });
+}
+
+//Function to find where every block starts in a payload of size bytes, false if the blocks do not fit in it.
+//blockOffset receives one offset per block followed by the end of the last block.
+bool blockOffsets(const StreamHeader& header, size_t size, vector<uint64_t>& blockOffset)
+{
+    blockOffset.assign(1, 0);
+    for (uint64_t bytes : header.blockBytes)
+    {
+        if (bytes > size - blockOffset.back())
+        {
+            return false;
+        }
+        blockOffset.push_back(blockOffset.back() + bytes);
+    }
+    return true;
+}
+
+//Function to decode the blocked payload of size bytes and write the message to out. Blocks are decoded a window of
+//at most DECODE_WINDOW symbols at a time, so the memory used does not grow with the message. False if the payload
+//is truncated.
+bool decodeBlocksTo(ThreadPool& pool, const StreamHeader& header, const StreamCodec& codec, DecodeMode mode, const unsigned char* payload, size_t size, ostream& out)
+{
+    vector<uint64_t> blockOffset;
+    if (!blockOffsets(header, size, blockOffset))
+    {
+        return false;
+    }
+    uint64_t blocks = header.blockBytes.size();
+    uint64_t perWindow = DECODE_WINDOW / header.blockSymbols; //at least 64, the header bounds the block size
+    perWindow = perWindow < blocks ? perWindow : blocks;
+    vector<char> window(perWindow * header.blockSymbols < header.messageLength ? perWindow * header.blockSymbols : header.messageLength);
+    for (uint64_t first = 0; first < blocks; first += perWindow)
+    {
+        uint64_t count = blocks - first < perWindow ? blocks - first : perWindow;
+        uint64_t end = (first + count) * header.blockSymbols;
+        uint64_t symbols = (end < header.messageLength ? end : header.messageLength) - first * header.blockSymbols;
+        decodeBlockRange(pool, header, codec, mode, payload, blockOffset, first, count, window.data());
+        TRACE_COUNT(TRACE_CODES_DECODED, symbols);
+        out.write(window.data(), symbols);
+    }
+    return true;
+}
+
+//Function to decode the payload of the container in data[0, size), whose header was read by reader, and write the
+//message to out: blocks on the pool, a single payload window by window. False if the payload is truncated.
+bool decodeContainerTo(ThreadPool& pool, BitReader& reader, const StreamHeader& header, const StreamCodec& codec, DecodeMode mode, const char* data, size_t size, ostream& out)
+{
+    if (header.blockSymbols == 0)
+    {
+        return decodeStreamTo(reader, codec, mode, out, header.messageLength);
+    }
+    uint64_t offset = reader.offset(); //the payload bits are not used yet, so the reader knows where they start
+    return decodeBlocksTo(pool, header, codec, mode, (const unsigned char*)data + offset, size - offset, out);
+}
+
+#endif
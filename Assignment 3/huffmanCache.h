@@ -0,0 +1,413 @@
+// Cache of built Huffman Trees keyed by a fingerprint of the alphabet.
+// Building the tree, its decode tables and its code table only depends on the (symbol, frequency) list, and files
+// processed in a batch mostly share a handful of alphabets. The cache keeps what was built for every alphabet seen
+// by the process and, when given a file, appends it there so the next processes map the file and copy the arrays
+// back instead of building them. The file only grows by whole records written under an exclusive lock, so several
+// processes can share it; a record cut short by a crash is ignored, and so is a record of another build whose node
+// layout differs. A fingerprint match is always confirmed by comparing the whole alphabet.
+#ifndef HUFFMANCACHE_H
+#define HUFFMANCACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "huffmanFlatTree.h"
+#include "huffmanSymbol.h"
+#include "huffmanTable.h"
+
+//Fingerprint of a (symbol, frequency) list, FNV-1a over the size and one word per symbol and per frequency
+template <typename Symbol, typename Count>
+uint64_t alphabetFingerprint(const Symbol character[], const Count frequency[], int size)
+{
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = (hash ^ (uint64_t)size) * prime;
+    for (int i = 0; i < size; i++)
+    {
+        hash = (hash ^ symbolValue(character[i])) * prime;
+        hash = (hash ^ (uint64_t)frequency[i]) * prime;
+    }
+    return hash;
+}
+
+//Everything built from one alphabet: the tree, its decode tables and the code of every leaf
+template <typename Symbol, typename Count>
+struct CachedAlphabet
+{
+    std::vector<Symbol> symbols;   //the key, compared in full on every fingerprint match
+    std::vector<Count> frequencies;
+    BasicFlatHuffmanTree<Symbol, Count> tree;
+    HuffmanDecodeTable table;
+    BasicFlatCodeTable<Symbol> codes;
+
+    bool matches(const Symbol character[], const Count frequency[], int size) const
+    {
+        return (int)symbols.size() == size && std::equal(symbols.begin(), symbols.end(), character) &&
+               std::equal(frequencies.begin(), frequencies.end(), frequency);
+    }
+};
+
+const char CACHE_FILE_MAGIC[8] = {'H', 'U', 'F', 'C', 'A', 'C', 'H', '1'};
+
+//Header of one record of the cache file, followed by the arrays of the alphabet in this order: symbols,
+//frequencies, tree nodes, decode table entries, leaf order, code start, code length and the code characters.
+//The arrays are copied as they are in memory, the sizes of the types let a build with another layout skip them.
+//A record whose checksum does not match is built again, and its indices are checked before they are used.
+struct CacheRecordHeader
+{
+    uint64_t bytes;       //size of the record, this header included, a multiple of 8
+    uint64_t fingerprint;
+    uint32_t symbolBytes; //sizeof(Symbol)
+    uint32_t countBytes;  //sizeof(Count)
+    uint32_t nodeBytes;   //sizeof(BasicFlatHuffmanNode<Symbol, Count>)
+    uint32_t entryBytes;  //sizeof(DecodeEntry)
+    uint32_t symbols;
+    int32_t root;
+    uint32_t tableEntries;
+    int32_t rootBits;
+    int32_t maxLength;
+    uint32_t codeBytes;   //number of code characters of every leaf together
+    uint64_t checksum;    //cacheChecksum of the arrays
+};
+
+//Checksum of size bytes, four independent multiply-xor chains over 8 byte words so it keeps up with memcpy
+uint64_t cacheChecksum(const char* data, size_t size)
+{
+    const uint64_t prime = 0x9e3779b97f4a7c15ull;
+    uint64_t lane[4] = {size, 1, 2, 3};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * k, 8);
+            lane[k] = (lane[k] ^ word) * prime;
+            lane[k] ^= lane[k] >> 29;
+        }
+    }
+    uint64_t hash = lane[0] ^ (lane[1] * 3) ^ (lane[2] * 5) ^ (lane[3] * 7);
+    for (; i < size; i++)
+    {
+        hash = (hash ^ (unsigned char)data[i]) * prime;
+    }
+    return hash ^ (hash >> 31);
+}
+
+template <typename Symbol, typename Count>
+class HuffmanCache
+{
+public:
+    typedef CachedAlphabet<Symbol, Count> Entry;
+
+    HuffmanCache() : fd(-1), mapped(nullptr), mappedSize(0), validSize(0), memoryHits(0), fileHits(0), misses(0) {}
+
+    ~HuffmanCache()
+    {
+        if (mapped)
+        {
+            munmap((void*)mapped, mappedSize);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    HuffmanCache(const HuffmanCache&) = delete;
+    HuffmanCache& operator=(const HuffmanCache&) = delete;
+
+    //Map the cache file at path, creating it if needed, and index the records already in it.
+    //False if the file cannot be used, the cache then only keeps what this process builds.
+    bool open(const char* path)
+    {
+        fd = ::open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        flock(fd, LOCK_SH); //a record being appended is either all there or not at all
+        struct stat info;
+        bool usable = fstat(fd, &info) == 0;
+        if (usable && info.st_size > 0)
+        {
+            void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            usable = address != MAP_FAILED;
+            if (usable)
+            {
+                mapped = (const char*)address;
+                mappedSize = info.st_size;
+                usable = indexRecords();
+            }
+        }
+        flock(fd, LOCK_UN);
+        if (!usable)
+        {
+            close(fd);
+            fd = -1;
+        }
+        return usable;
+    }
+
+    //Tree, decode tables and code table of the alphabet, from this process, from the file or built on a miss.
+    //The entry lives as long as the cache.
+    const Entry& lookup(const Symbol character[], const Count frequency[], int size)
+    {
+        uint64_t fingerprint = alphabetFingerprint(character, frequency, size);
+        auto built = entries.equal_range(fingerprint);
+        for (auto it = built.first; it != built.second; ++it)
+        {
+            if (it->second->matches(character, frequency, size))
+            {
+                memoryHits++;
+                return *it->second;
+            }
+        }
+
+        std::unique_ptr<Entry> entry(new Entry());
+        auto stored = fileRecords.equal_range(fingerprint);
+        for (auto it = stored.first; it != stored.second; ++it)
+        {
+            if (loadRecord(it->second, character, frequency, size, *entry))
+            {
+                fileHits++;
+                return *entries.emplace(fingerprint, std::move(entry))->second;
+            }
+        }
+
+        misses++;
+        entry->symbols.assign(character, character + size);
+        entry->frequencies.assign(frequency, frequency + size);
+        buildFlatHuffmanTree(character, frequency, size, entry->tree);
+        entry->table = buildDecodeTable(entry->tree);
+        buildFlatCodeTable(entry->tree, entry->codes);
+        appendRecord(fingerprint, *entry);
+        return *entries.emplace(fingerprint, std::move(entry))->second;
+    }
+
+    //lookups answered by this process, by the file, and built
+    long long hitsInMemory() const
+    {
+        return memoryHits;
+    }
+
+    long long hitsInFile() const
+    {
+        return fileHits;
+    }
+
+    long long builds() const
+    {
+        return misses;
+    }
+
+private:
+    typedef BasicFlatHuffmanNode<Symbol, Count> Node;
+
+    int fd;
+    const char* mapped;
+    size_t mappedSize;
+    size_t validSize; //end of the last whole record of the mapped file
+    std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> entries;
+    std::unordered_multimap<uint64_t, size_t> fileRecords; //offset of every record of this layout in the file
+    long long memoryHits;
+    long long fileHits;
+    long long misses;
+
+    //walk the mapped records, false if the file is not a cache file
+    bool indexRecords()
+    {
+        if (mappedSize < sizeof(CACHE_FILE_MAGIC) || memcmp(mapped, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)) != 0)
+        {
+            return false;
+        }
+        size_t offset = sizeof(CACHE_FILE_MAGIC);
+        while (mappedSize - offset >= sizeof(CacheRecordHeader))
+        {
+            CacheRecordHeader header;
+            memcpy(&header, mapped + offset, sizeof(header));
+            if (header.bytes < sizeof(header) || header.bytes > mappedSize - offset)
+            {
+                break; //cut short, the rest of the file is ignored and cut off by the next append
+            }
+            if (header.symbolBytes == sizeof(Symbol) && header.countBytes == sizeof(Count) &&
+                header.nodeBytes == sizeof(Node) && header.entryBytes == sizeof(DecodeEntry))
+            {
+                fileRecords.emplace(header.fingerprint, offset);
+            }
+            offset += header.bytes;
+        }
+        validSize = offset;
+        return true;
+    }
+
+    //size in bytes of the arrays following a record header
+    static uint64_t recordArrays(const CacheRecordHeader& header)
+    {
+        uint64_t nodes = header.symbols > 0 ? 2 * (uint64_t)header.symbols - 1 : 0;
+        return (uint64_t)header.symbols * (sizeof(Symbol) + sizeof(Count) + sizeof(int32_t) + sizeof(size_t) + sizeof(int)) +
+               nodes * sizeof(Node) + (uint64_t)header.tableEntries * sizeof(DecodeEntry) + header.codeBytes;
+    }
+
+    //copy count items of the array at in to out, moving in past it
+    template <typename Item>
+    static void readArray(const char*& in, std::vector<Item>& out, size_t count)
+    {
+        out.resize(count);
+        memcpy((void*)out.data(), in, count * sizeof(Item));
+        in += count * sizeof(Item);
+    }
+
+    //Load the record at offset into entry if it holds this alphabet and its indices are all in range
+    bool loadRecord(size_t offset, const Symbol character[], const Count frequency[], int size, Entry& entry)
+    {
+        CacheRecordHeader header;
+        memcpy(&header, mapped + offset, sizeof(header));
+        if ((int)header.symbols != size || size == 0 || sizeof(header) + recordArrays(header) > header.bytes)
+        {
+            return false;
+        }
+        const char* in = mapped + offset + sizeof(header);
+        if (cacheChecksum(in, recordArrays(header)) != header.checksum)
+        {
+            return false;
+        }
+        readArray(in, entry.symbols, size);
+        readArray(in, entry.frequencies, size);
+        if (!entry.matches(character, frequency, size))
+        {
+            return false;
+        }
+        readArray(in, entry.tree.nodes, 2 * size - 1);
+        readArray(in, entry.table.entries, header.tableEntries);
+        readArray(in, entry.codes.order, size);
+        readArray(in, entry.codes.start, size);
+        readArray(in, entry.codes.length, size);
+        entry.codes.codes.assign(in, header.codeBytes);
+        entry.tree.root = header.root;
+        entry.table.rootBits = header.rootBits;
+        entry.table.maxLength = header.maxLength;
+        if (!validRecord(entry))
+        {
+            return false;
+        }
+        entry.codes.leafOf.clear();
+        for (int32_t leaf : entry.codes.order)
+        {
+            entry.codes.leafOf.set(entry.tree.nodes[leaf].character, leaf);
+        }
+        return true;
+    }
+
+    //a damaged record must not send the decoders out of their arrays
+    static bool validRecord(const Entry& entry)
+    {
+        int32_t nodes = entry.tree.nodes.size();
+        int32_t leaves = (nodes + 1) / 2;
+        if (entry.tree.root < 0 || entry.tree.root >= nodes)
+        {
+            return false;
+        }
+        for (int32_t i = 0; i < nodes; i++)
+        {
+            const Node& node = entry.tree.nodes[i];
+            bool leaf = i < leaves;
+            if (leaf ? node.left != -1 || node.right != -1 : node.left < 0 || node.left >= i || node.right < 0 || node.right >= i)
+            {
+                return false;
+            }
+        }
+        const HuffmanDecodeTable& table = entry.table;
+        if (table.rootBits < 1 || table.rootBits > 24 || table.maxLength < 0 || table.entries.size() < (1u << table.rootBits))
+        {
+            return false;
+        }
+        for (const DecodeEntry& decode : table.entries)
+        {
+            if (decode.subBits && (decode.subBits > 24 || decode.value + (1ull << decode.subBits) > table.entries.size()))
+            {
+                return false;
+            }
+        }
+        for (int32_t i = 0; i < leaves; i++)
+        {
+            const BasicFlatCodeTable<Symbol>& codes = entry.codes;
+            if (codes.order[i] < 0 || codes.order[i] >= leaves || codes.length[i] < 0 || codes.start[i] > codes.codes.size() ||
+                (size_t)codes.length[i] > codes.codes.size() - codes.start[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //append the record of a built alphabet to the file, in one write under an exclusive lock
+    void appendRecord(uint64_t fingerprint, const Entry& entry)
+    {
+        if (fd < 0 || entry.symbols.empty())
+        {
+            return;
+        }
+        CacheRecordHeader header = {};
+        header.fingerprint = fingerprint;
+        header.symbolBytes = sizeof(Symbol);
+        header.countBytes = sizeof(Count);
+        header.nodeBytes = sizeof(Node);
+        header.entryBytes = sizeof(DecodeEntry);
+        header.symbols = entry.symbols.size();
+        header.root = entry.tree.root;
+        header.tableEntries = entry.table.entries.size();
+        header.rootBits = entry.table.rootBits;
+        header.maxLength = entry.table.maxLength;
+        header.codeBytes = entry.codes.codes.size();
+        header.bytes = (sizeof(header) + recordArrays(header) + 7) & ~7ull;
+
+        std::string record;
+        record.reserve(header.bytes);
+        record.append((const char*)&header, sizeof(header));
+        record.append((const char*)entry.symbols.data(), entry.symbols.size() * sizeof(Symbol));
+        record.append((const char*)entry.frequencies.data(), entry.frequencies.size() * sizeof(Count));
+        record.append((const char*)entry.tree.nodes.data(), entry.tree.nodes.size() * sizeof(Node));
+        record.append((const char*)entry.table.entries.data(), entry.table.entries.size() * sizeof(DecodeEntry));
+        record.append((const char*)entry.codes.order.data(), entry.codes.order.size() * sizeof(int32_t));
+        record.append((const char*)entry.codes.start.data(), entry.codes.start.size() * sizeof(size_t));
+        record.append((const char*)entry.codes.length.data(), entry.codes.length.size() * sizeof(int));
+        record += entry.codes.codes;
+        header.checksum = cacheChecksum(record.data() + sizeof(header), record.size() - sizeof(header));
+        memcpy(&record[0], &header, sizeof(header));
+        record.resize(header.bytes, '\0');
+
+        flock(fd, LOCK_EX);
+        struct stat info;
+        if (fstat(fd, &info) == 0)
+        {
+            if (mapped && (size_t)info.st_size == mappedSize && validSize < mappedSize && ftruncate(fd, validSize) == 0)
+            {
+                info.st_size = validSize; //the file still ends with the record cut short that open found
+            }
+            if (info.st_size == 0)
+            {
+                record.insert(0, CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC)); //first record of a new file
+            }
+            if (write(fd, record.data(), record.size()) != (ssize_t)record.size() && ftruncate(fd, info.st_size) != 0)
+            {
+                //the next record would start in the middle of this one, stop appending
+                close(fd); //releases the lock
+                fd = -1;
+                return;
+            }
+        }
+        flock(fd, LOCK_UN);
+    }
+};
+
+#endif
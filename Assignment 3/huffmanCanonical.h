@@ -0,0 +1,213 @@
+// Canonical Huffman codes.
+// Only the code length of every symbol is taken from the Huffman algorithm. The codes themselves are assigned in
+// (length, symbol) order, so the whole code is described by the number of codes of each length and the symbols
+// in that order: a few hundred bytes instead of a pointer tree.
+#ifndef HUFFMANCANONICAL_H
+#define HUFFMANCANONICAL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "huffmanTable.h"
+#include "huffmanFlatTree.h"
+
+//longest code a canonical code can describe
+const int MAX_CODE_LENGTH = 64;
+
+//length counts and symbols sorted by (length, symbol)
+struct CanonicalCode
+{
+    int n;                                //number of symbols
+    int maxLength;                        //longest code
+    uint16_t count[MAX_CODE_LENGTH + 1];  //number of codes of each length
+    unsigned char symbols[256];           //symbols in canonical order
+};
+
+//Function to compute the code length of every symbol.
+//Runs the same merges as init_pq and buildHuffmanTree in a flat tree, so the lengths equal the depths in the
+//Huffman Tree. lengths follows the order of the input arrays.
+void computeCodeLengths(const char character[], const int frequency[], int size, vector<int>& lengths)
+{
+    FlatHuffmanTree tree;
+    buildFlatHuffmanTree(character, frequency, size, tree);
+    vector<int> depth;
+    flatTreeDepths(tree, depth);
+    lengths.assign(depth.begin(), depth.begin() + size);
+}
+
+//Function to compute code lengths of at most maxLength bits with the smallest total length, by package-merge.
+//When the Huffman code lengths already fit they are kept as they are. Returns false if size symbols do not fit in
+//codes of maxLength bits.
+bool computeLimitedCodeLengths(const char character[], const int frequency[], int size, int maxLength, vector<int>& lengths)
+{
+    computeCodeLengths(character, frequency, size, lengths);
+    if (maxLength <= 0 || size <= 1 || *max_element(lengths.begin(), lengths.end()) <= maxLength)
+    {
+        return true;
+    }
+    if (maxLength < 31 && size > (1 << maxLength))
+    {
+        return false;
+    }
+
+    //a leaf is a symbol, a package the pair of consecutive items at index 2 * package and 2 * package + 1 of the
+    //list one level deeper; every level lists the leaves and packages by weight, leaves first on ties
+    struct Item
+    {
+        uint64_t weight;
+        int symbol; //-1 for a package
+    };
+    vector<int> order(size);
+    for (int i = 0; i < size; i++)
+    {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b) { return frequency[a] < frequency[b]; });
+    vector<Item> leaves(size);
+    for (int i = 0; i < size; i++)
+    {
+        leaves[i] = {(uint64_t)max(frequency[order[i]], 0), order[i]};
+    }
+
+    vector<vector<Item>> levels(maxLength); //levels[0] is the deepest level, levels[maxLength - 1] the top one
+    levels[0] = leaves;
+    for (int level = 1; level < maxLength; level++)
+    {
+        const vector<Item>& below = levels[level - 1];
+        vector<Item>& list = levels[level];
+        list.reserve(size + below.size() / 2);
+        size_t leaf = 0;
+        size_t pair = 0;
+        while (leaf < leaves.size() || pair + 1 < below.size())
+        {
+            bool takeLeaf = pair + 1 >= below.size() || (leaf < leaves.size() && leaves[leaf].weight <= below[pair].weight + below[pair + 1].weight);
+            if (takeLeaf)
+            {
+                list.push_back(leaves[leaf++]);
+            }
+            else
+            {
+                list.push_back({below[pair].weight + below[pair + 1].weight, -1});
+                pair += 2;
+            }
+        }
+    }
+
+    //the first 2n - 2 items of the top level form the code: every time a symbol is selected its code grows by one
+    lengths.assign(size, 0);
+    size_t selected = 2 * (size_t)size - 2;
+    for (int level = maxLength - 1; level >= 0 && selected > 0; level--)
+    {
+        size_t packages = 0;
+        for (size_t i = 0; i < selected; i++)
+        {
+            if (levels[level][i].symbol >= 0)
+            {
+                lengths[levels[level][i].symbol]++;
+            }
+            else
+            {
+                packages++;
+            }
+        }
+        selected = 2 * packages;
+    }
+    return true;
+}
+
+//Function to build the canonical code from the symbols and their code lengths.
+//Returns false if a code is longer than MAX_CODE_LENGTH or there are more symbols than byte values.
+bool buildCanonicalCode(const char character[], const vector<int>& lengths, int size, CanonicalCode& code)
+{
+    if (size > 256)
+    {
+        return false;
+    }
+    code.n = size;
+    code.maxLength = 0;
+    for (int len = 0; len <= MAX_CODE_LENGTH; len++)
+    {
+        code.count[len] = 0;
+    }
+    vector<int> order(size);
+    for (int i = 0; i < size; i++)
+    {
+        if (lengths[i] > MAX_CODE_LENGTH)
+        {
+            return false;
+        }
+        order[i] = i;
+        code.count[lengths[i]]++;
+        code.maxLength = lengths[i] > code.maxLength ? lengths[i] : code.maxLength;
+    }
+    //canonical order: shorter codes first, then by byte value
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        if (lengths[a] != lengths[b])
+        {
+            return lengths[a] < lengths[b];
+        }
+        return (unsigned char)character[a] < (unsigned char)character[b];
+    });
+    for (int i = 0; i < size; i++)
+    {
+        code.symbols[i] = (unsigned char)character[order[i]];
+    }
+    return true;
+}
+
+//Function to list every (symbol, code, length) in canonical order, which is also increasing code order.
+//Each code is the previous one plus one, shifted left when the length grows.
+vector<SymbolCode> canonicalCodes(const CanonicalCode& code)
+{
+    vector<SymbolCode> codes(code.n);
+    uint64_t next = 0;
+    int index = 0;
+    for (int len = 0; len <= code.maxLength; len++)
+    {
+        for (int i = 0; i < code.count[len]; i++, index++)
+        {
+            codes[index].symbol = code.symbols[index];
+            codes[index].bits = next++;
+            codes[index].length = len;
+        }
+        next <<= 1;
+    }
+    return codes;
+}
+
+//Function to decode one symbol bit by bit using only the length counts.
+//nextBit returns the next bit of the code. The first code of each length is tracked instead of a tree.
+template <typename NextBit>
+int decodeCanonicalSymbol(const CanonicalCode& code, NextBit nextBit)
+{
+    if (code.maxLength == 0)
+    {
+        return code.symbols[0];
+    }
+    uint64_t value = 0; //bits read so far
+    uint64_t first = 0; //first code of the current length
+    int index = 0;      //index in symbols of the first code of the current length
+    for (int len = 1; len <= code.maxLength; len++)
+    {
+        value |= nextBit();
+        uint64_t count = code.count[len];
+        if (value - first < count)
+        {
+            return code.symbols[index + (value - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+    return -1; //not a valid code
+}
+
+//Canonical counterpart of getChar for a binary code written as '0'/'1' characters
+char getCanonicalChar(const CanonicalCode& code, const string& binaryCode)
+{
+    size_t pos = 0;
+    return (char)decodeCanonicalSymbol(code, [&]() { return pos < binaryCode.size() && binaryCode[pos++] == '1'; });
+}
+
+#endif
@@ -0,0 +1,296 @@
+// Encoder for the Huffman Tree: byte histogram, symbol to code table and packed bitstream writer.
+// Produces the container read by huffmanStream.h.
+#ifndef HUFFMANENCODE_H
+#define HUFFMANENCODE_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "huffmanTree.h"
+#include "huffmanStream.h"
+#include "huffmanCanonical.h"
+#include "simdKernels.h"
+
+//code of one symbol, right aligned in bits
+struct HuffmanCode
+{
+    uint64_t bits;
+    int length;
+    int frequency;
+};
+
+//code of every byte value, length -1 for bytes that are not in the alphabet
+struct HuffmanCodeTable
+{
+    HuffmanCode codes[256];
+};
+
+//Function to count the frequency of every byte value, with the best histogram kernel of the processor
+void countFrequencies(const unsigned char* data, size_t size, uint64_t counts[256])
+{
+    countFrequenciesWith(simdLevel(), data, size, counts);
+}
+
+//Function to collect the code of every leaf of the flat tree.
+//Returns false if a code does not fit in 64 bits.
+bool buildCodeTable(const FlatHuffmanTree& tree, HuffmanCodeTable& table)
+{
+    for (int s = 0; s < 256; s++)
+    {
+        table.codes[s].bits = 0;
+        table.codes[s].length = -1;
+        table.codes[s].frequency = 0;
+    }
+    vector<SymbolCode> codes;
+    if (!flatTreeCodes(tree, codes))
+    {
+        return false;
+    }
+    for (const SymbolCode& code : codes)
+    {
+        table.codes[code.symbol].bits = code.bits;
+        table.codes[code.symbol].length = code.length;
+    }
+    //the leaves are the first nodes of the array
+    for (size_t i = 0; i < tree.nodes.size() && tree.nodes[i].left < 0; i++)
+    {
+        table.codes[(unsigned char)tree.nodes[i].character].frequency = tree.nodes[i].frequency;
+    }
+    return true;
+}
+
+//Function to fill the code table with canonical codes of the Huffman code lengths, no tree is built.
+//A maxLength above 0 limits the code lengths to maxLength bits.
+//Returns false if a code is longer than MAX_CODE_LENGTH or the alphabet does not fit in maxLength bits.
+bool buildCanonicalCodeTable(const char character[], const int frequency[], int size, HuffmanCodeTable& table, int maxLength = 0)
+{
+    vector<int> lengths;
+    if (!computeLimitedCodeLengths(character, frequency, size, maxLength, lengths))
+    {
+        return false;
+    }
+    CanonicalCode canonical;
+    if (!buildCanonicalCode(character, lengths, size, canonical))
+    {
+        return false;
+    }
+    for (int s = 0; s < 256; s++)
+    {
+        table.codes[s].bits = 0;
+        table.codes[s].length = -1;
+        table.codes[s].frequency = 0;
+    }
+    for (const SymbolCode& code : canonicalCodes(canonical))
+    {
+        table.codes[code.symbol].bits = code.bits;
+        table.codes[code.symbol].length = code.length;
+    }
+    for (int i = 0; i < size; i++)
+    {
+        table.codes[(unsigned char)character[i]].frequency = frequency[i];
+    }
+    return true;
+}
+
+//Writes a container to an output stream through a 64 bit buffer, flushed in large blocks.
+class BitWriter
+{
+public:
+    BitWriter(ostream& output, size_t blockSize = 1 << 16) : out(output), block(blockSize + 8), pos(0), buffer(0), count(0) {}
+
+    ~BitWriter()
+    {
+        flush();
+    }
+
+    //write one byte, only valid before any code bits
+    void writeByte(int byte)
+    {
+        if (pos >= block.size() - 8)
+        {
+            flushBlock();
+        }
+        block[pos++] = (unsigned char)byte;
+    }
+
+    //write an unsigned LEB128 integer
+    void writeVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            writeByte((int)(value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        writeByte((int)value);
+    }
+
+    //append the low length bits of code, most significant first
+    void write(uint64_t code, int length)
+    {
+        if (length > 56)
+        {
+            //split long codes so the buffer never has to hold more than 63 bits
+            write(code >> 32, length - 32);
+            write(code & 0xffffffffull, 32);
+            return;
+        }
+        if (count + length > 64)
+        {
+            flushBits();
+        }
+        if (length)
+        {
+            buffer |= code << (64 - count - length);
+            count += length;
+        }
+    }
+
+    //flush the whole bytes of the buffer, afterwards at least 57 bits can be appended
+    void makeRoom()
+    {
+        flushBits();
+    }
+
+    //append without checking for room, length has to be 1..64 minus the pending bits
+    void append(uint64_t code, int length)
+    {
+        buffer |= code << (64 - count - length);
+        count += length;
+    }
+
+    //pad the last byte with zero bits and write everything out
+    void flush()
+    {
+        flushBits();
+        if (count)
+        {
+            block[pos++] = (unsigned char)(buffer >> 56);
+            buffer = 0;
+            count = 0;
+        }
+        flushBlock();
+        out.flush();
+    }
+
+private:
+    ostream& out;
+    vector<unsigned char> block;
+    size_t pos;
+    uint64_t buffer; //pending bits, left aligned
+    int count;       //number of pending bits
+
+    //move the whole bytes of the buffer to the block with one 8 byte store
+    void flushBits()
+    {
+        if (pos >= block.size() - 8)
+        {
+            flushBlock();
+        }
+        uint64_t word = __builtin_bswap64(buffer);
+        memcpy(&block[pos], &word, 8);
+        int bytes = count >> 3;
+        pos += bytes;
+        buffer = bytes == 8 ? 0 : buffer << (bytes * 8);
+        count &= 7;
+    }
+
+    void flushBlock()
+    {
+        out.write((const char*)block.data(), pos);
+        pos = 0;
+    }
+};
+
+//Function to write the container header for the alphabet and the message length.
+//A maxLength above 0 is stored with STREAM_FLAG_LIMITED, flags has to include STREAM_FLAG_CANONICAL then.
+void writeStreamHeader(BitWriter& writer, const vector<char>& symbols, const vector<int>& frequencies, uint64_t messageLength, int flags = 0, int maxLength = 0)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        writer.writeByte(HUFFMAN_STREAM_MAGIC[i]);
+    }
+    writer.writeByte(HUFFMAN_STREAM_VERSION);
+    writer.writeByte(maxLength > 0 ? flags | STREAM_FLAG_LIMITED : flags);
+    if (maxLength > 0)
+    {
+        writer.writeByte(maxLength);
+    }
+    writer.writeByte(symbols.size() & 0xff);
+    writer.writeByte(symbols.size() >> 8);
+    for (size_t i = 0; i < symbols.size(); i++)
+    {
+        writer.writeByte((unsigned char)symbols[i]);
+        writer.writeVarint(frequencies[i]);
+    }
+    writer.writeVarint(messageLength);
+}
+
+//Function to append the code of every byte of data to the payload.
+//As many codes as always fit in 56 bits are appended between two flushes of the bit buffer.
+void encodePayload(BitWriter& writer, const HuffmanCodeTable& table, const unsigned char* data, size_t size)
+{
+    int maxLength = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        maxLength = table.codes[s].length > maxLength ? table.codes[s].length : maxLength;
+    }
+    if (maxLength == 0)
+    {
+        //a single symbol has the empty code, the payload is empty
+        return;
+    }
+
+    size_t i = 0;
+    size_t group = maxLength <= 56 ? 56 / maxLength : 0;
+    if (group)
+    {
+        for (; i + group <= size; i += group)
+        {
+            writer.makeRoom();
+            for (size_t g = 0; g < group; g++)
+            {
+                const HuffmanCode& code = table.codes[data[i + g]];
+                writer.append(code.bits, code.length);
+            }
+        }
+    }
+    for (; i < size; i++)
+    {
+        const HuffmanCode& code = table.codes[data[i]];
+        writer.write(code.bits, code.length);
+    }
+}
+
+//Function to write a whole blocked container (STREAM_FLAG_BLOCKS): the message is cut into blocks of blockSymbols
+//symbols, every block is encoded as a payload of its own and their sizes are written to the header, so a decoder
+//can start at any block.
+void writeBlockedStream(ostream& out, const vector<char>& symbols, const vector<int>& frequencies, const HuffmanCodeTable& table, const unsigned char* data, size_t size, uint64_t blockSymbols, int flags = 0, int maxLength = 0)
+{
+    vector<string> blocks;
+    for (size_t first = 0; first < size; first += blockSymbols)
+    {
+        ostringstream block;
+        BitWriter blockWriter(block);
+        encodePayload(blockWriter, table, data + first, size - first < blockSymbols ? size - first : blockSymbols);
+        blockWriter.flush();
+        blocks.push_back(block.str());
+    }
+    BitWriter writer(out);
+    writeStreamHeader(writer, symbols, frequencies, size, flags | STREAM_FLAG_BLOCKS, maxLength);
+    writer.writeVarint(blockSymbols);
+    writer.writeVarint(blocks.size());
+    for (const string& block : blocks)
+    {
+        writer.writeVarint(block.size());
+    }
+    writer.flush();
+    for (const string& block : blocks)
+    {
+        out.write(block.data(), block.size());
+    }
+}
+
+#endif
@@ -0,0 +1,519 @@
+// Huffman Tree stored in one contiguous array.
+// The 2n-1 nodes live in a vector reused as an arena: children are 32 bit indices instead of pointers, there are no
+// string members and no per-node allocation, so a rebuild only reuses memory that is already there.
+// The tree is a template over the symbol and frequency types of huffmanSymbol.h; FlatHuffmanTree is the byte one.
+#ifndef HUFFMANFLATTREE_H
+#define HUFFMANFLATTREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "huffmanSymbol.h"
+#include "huffmanTable.h"
+#include "huffmanTrace.h"
+
+//compact node, left and right are -1 for a leaf
+template <typename Symbol, typename Count>
+struct BasicFlatHuffmanNode
+{
+    int32_t left;
+    int32_t right;
+    Count frequency;
+    Symbol character;
+};
+
+//The leaves are stored first in input order, internal nodes follow in creation order.
+//The index of a node is its counter, so ties are broken exactly like Compare does.
+template <typename Symbol, typename Count>
+struct BasicFlatHuffmanTree
+{
+    typedef Symbol SymbolType;
+    typedef BasicFlatHuffmanNode<Symbol, Count> Node;
+
+    vector<Node> nodes;
+    vector<int32_t> heap;  //priority queue storage or sorted leaves, kept between builds
+    vector<int32_t> queue; //internal node queue of the two-queue build, kept between builds
+    int32_t root;
+};
+
+//byte symbols and int frequencies, the 16 byte node of the assignment formats
+typedef BasicFlatHuffmanNode<char, int> FlatHuffmanNode;
+typedef BasicFlatHuffmanTree<char, int> FlatHuffmanTree;
+//byte symbols with 64 bit frequencies, for messages of 2^31 characters or more
+typedef BasicFlatHuffmanTree<char, uint64_t> FlatHuffmanTree64;
+
+//Orders node indices exactly like Compare orders HuffmanTreeNode pointers
+template <typename Node>
+class FlatCompare
+{
+public:
+    const vector<Node>* nodes;
+
+    FlatCompare(const vector<Node>* treeNodes) : nodes(treeNodes) {}
+
+    bool operator() (int32_t firstIndex, int32_t secondIndex) const
+    {
+        const Node& first = (*nodes)[firstIndex];
+        const Node& second = (*nodes)[secondIndex];
+        if (first.frequency == second.frequency)
+        {
+            if (first.character == second.character)
+            {
+                return firstIndex < secondIndex; //the index is the counter.
+            }
+            return symbolRank(first.character) > symbolRank(second.character); //compare ascii value if frequency is equal
+        }
+        return first.frequency > second.frequency; //compare frequency
+    }
+};
+
+//select how the merges are ordered, both give the same tree
+enum TreeBuildMode
+{
+    BUILD_HEAP,      //priority queue of every node, O(n log n)
+    BUILD_TWO_QUEUE  //sorted leaves and a queue of internal nodes, O(n) once the leaves are sorted
+};
+
+//Function to build the Huffman Tree with a binary heap into the arena of tree.
+//Performs the same merges as init_pq and buildHuffmanTree.
+template <typename Symbol, typename Count>
+void buildFlatHuffmanTreeHeap(const Symbol character[], const Count frequency[], int size, BasicFlatHuffmanTree<Symbol, Count>& tree)
+{
+    tree.nodes.clear();
+    tree.heap.clear();
+    tree.nodes.reserve(2 * size - 1);
+    for (int i = 0; i < size; i++)
+    {
+        tree.nodes.push_back({-1, -1, frequency[i], character[i]});
+        tree.heap.push_back(i);
+    }
+
+    FlatCompare<BasicFlatHuffmanNode<Symbol, Count>> compare(&tree.nodes);
+    make_heap(tree.heap.begin(), tree.heap.end(), compare);
+    while (tree.heap.size() > 1)
+    {
+        //extract the two nodes with least frequency or ASCII value if equal
+        pop_heap(tree.heap.begin(), tree.heap.end(), compare);
+        int32_t left = tree.heap.back();
+        tree.heap.pop_back();
+        pop_heap(tree.heap.begin(), tree.heap.end(), compare);
+        int32_t right = tree.heap.back();
+        tree.heap.pop_back();
+
+        //internal node which the value is the sum of its child frequency
+        int32_t internal = tree.nodes.size();
+        tree.nodes.push_back({left, right, tree.nodes[left].frequency + tree.nodes[right].frequency, Symbol()});
+        tree.heap.push_back(internal);
+        push_heap(tree.heap.begin(), tree.heap.end(), compare);
+    }
+    tree.root = tree.heap[0];
+}
+
+//Function to build the Huffman Tree with the two-queue algorithm into the arena of tree.
+//Compare extracts by (frequency, signed character, newest counter first). Leaves are sorted once in that order.
+//Internal nodes are created with non-decreasing frequency, so they only need a queue, except that among equal
+//frequencies the newest one is extracted first: the run of equal frequency at the front of the queue is
+//consumed from its end, like a stack, and a new node of that frequency is pushed on top of it.
+template <typename Symbol, typename Count>
+void buildFlatHuffmanTreeTwoQueue(const Symbol character[], const Count frequency[], int size, BasicFlatHuffmanTree<Symbol, Count>& tree)
+{
+    tree.nodes.clear();
+    tree.nodes.reserve(2 * size - 1);
+    tree.heap.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        tree.nodes.push_back({-1, -1, frequency[i], character[i]});
+        tree.heap[i] = i;
+    }
+
+    //a is extracted before b when Compare gives b the lower priority
+    FlatCompare<BasicFlatHuffmanNode<Symbol, Count>> compare(&tree.nodes);
+    auto before = [&](int32_t a, int32_t b) { return compare(b, a); };
+    if (!is_sorted(tree.heap.begin(), tree.heap.end(), before))
+    {
+        sort(tree.heap.begin(), tree.heap.end(), before);
+    }
+
+    vector<int32_t>& q = tree.queue;
+    q.resize(size);
+    size_t leafHead = 0; //next leaf in tree.heap
+    size_t runLo = 0;    //first slot of the front run
+    long runTop = -1;    //last live slot of the front run, the run is empty when runTop < runLo
+    size_t runEnd = 0;   //one past the front run
+    size_t tail = 0;     //one past the last internal node
+
+    //make sure the front run is loaded, false if there is no internal node left
+    auto loadRun = [&]() {
+        if (runTop >= (long)runLo)
+        {
+            return true;
+        }
+        if (runEnd == tail)
+        {
+            return false;
+        }
+        runLo = runEnd;
+        runEnd = runLo + 1;
+        while (runEnd < tail && tree.nodes[q[runEnd]].frequency == tree.nodes[q[runLo]].frequency)
+        {
+            runEnd++;
+        }
+        runTop = runEnd - 1;
+        return true;
+    };
+
+    //extract the next node from whichever queue holds it
+    auto extract = [&]() {
+        bool internalLeft = loadRun();
+        if (leafHead < (size_t)size && (!internalLeft || before(tree.heap[leafHead], q[runTop])))
+        {
+            return tree.heap[leafHead++];
+        }
+        return q[runTop--];
+    };
+
+    for (int merge = 0; merge < size - 1; merge++)
+    {
+        int32_t left = extract();
+        int32_t right = extract();
+        int32_t internal = tree.nodes.size();
+        Count sum = tree.nodes[left].frequency + tree.nodes[right].frequency;
+        tree.nodes.push_back({left, right, sum, Symbol()});
+
+        if (runTop >= (long)runLo && tree.nodes[q[runTop]].frequency == sum)
+        {
+            //newest node of the front run's frequency goes on top, reusing a consumed slot when there is one
+            if (runTop + 1 == (long)runEnd)
+            {
+                runEnd++;
+                tail++;
+            }
+            q[++runTop] = internal;
+        }
+        else
+        {
+            q[tail++] = internal;
+        }
+    }
+    tree.root = tree.nodes.size() - 1;
+}
+
+//Function to build the Huffman Tree into the arena of tree, replacing what it held before
+template <typename Symbol, typename Count>
+void buildFlatHuffmanTree(const Symbol character[], const Count frequency[], int size, BasicFlatHuffmanTree<Symbol, Count>& tree, TreeBuildMode mode = BUILD_TWO_QUEUE)
+{
+    if (mode == BUILD_HEAP)
+    {
+        buildFlatHuffmanTreeHeap(character, frequency, size, tree);
+    }
+    else
+    {
+        buildFlatHuffmanTreeTwoQueue(character, frequency, size, tree);
+    }
+}
+
+//Function to compute the depth of every node. Parents come after their children in the array,
+//so one backwards pass from the root is enough.
+template <typename Tree>
+void flatTreeDepths(const Tree& tree, vector<int>& depth)
+{
+    depth.assign(tree.nodes.size(), 0);
+    for (int32_t i = tree.root; i >= 0; i--)
+    {
+        const typename Tree::Node& node = tree.nodes[i];
+        if (node.left >= 0)
+        {
+            depth[node.left] = depth[node.right] = depth[i] + 1;
+        }
+    }
+}
+
+//Function to list the code of every leaf from left to right, which is increasing code order.
+//Codes longer than 64 bits are not representable, the function returns false for them.
+template <typename Tree>
+bool flatTreeCodes(const Tree& tree, vector<SymbolCode>& codes)
+{
+    codes.clear();
+    vector<SymbolCode> stack; //symbol holds the node index while walking
+    stack.push_back({(uint32_t)tree.root, 0, 0});
+    while (!stack.empty())
+    {
+        SymbolCode top = stack.back();
+        stack.pop_back();
+        const typename Tree::Node& node = tree.nodes[top.symbol];
+        if (node.left < 0)
+        {
+            codes.push_back({symbolValue(node.character), top.bits, top.length});
+            continue;
+        }
+        if (top.length == 64)
+        {
+            return false;
+        }
+        //left edge is 0, right edge is 1
+        stack.push_back({(uint32_t)node.right, (top.bits << 1) | 1, top.length + 1});
+        stack.push_back({(uint32_t)node.left, top.bits << 1, top.length + 1});
+    }
+    return true;
+}
+
+//Function to compute the height of every node, the length of the longest code below it. Children come before their
+//parents in the array, so one forward pass up to the root is enough.
+template <typename Tree>
+void flatTreeHeights(const Tree& tree, vector<int>& height)
+{
+    height.assign(tree.nodes.size(), 0);
+    for (int32_t i = 0; i <= tree.root; i++)
+    {
+        const typename Tree::Node& node = tree.nodes[i];
+        if (node.left >= 0)
+        {
+            height[i] = 1 + (height[node.left] > height[node.right] ? height[node.left] : height[node.right]);
+        }
+    }
+}
+
+//node of the flat tree waiting to be placed in the decode table of width bits starting at offset,
+//code holds the depth bits already consumed inside that table
+struct FlatDecodeFill
+{
+    int32_t node;
+    uint32_t code;
+    int depth;
+    uint32_t offset;
+    int bits;
+};
+
+//Function to build the decode tables from the flat tree, the counterpart of the pointer tree buildDecodeTable.
+//The tree is walked directly, with an explicit stack, so codes of any length get sub tables.
+template <typename Symbol, typename Count>
+HuffmanDecodeTable buildDecodeTable(const BasicFlatHuffmanTree<Symbol, Count>& tree, int primaryBits = DEFAULT_PRIMARY_BITS)
+{
+    vector<int> height;
+    flatTreeHeights(tree, height);
+    HuffmanDecodeTable table;
+    table.maxLength = height[tree.root];
+
+    //a tree with a single leaf has the empty code, give it a one bit table whose entries consume nothing
+    int bits = table.maxLength < primaryBits ? table.maxLength : primaryBits;
+    table.rootBits = bits > 0 ? bits : 1;
+    table.entries.resize(1u << table.rootBits);
+    if (bits == 0)
+    {
+        DecodeEntry leaf = {symbolValue(tree.nodes[tree.root].character), 0, 0};
+        table.entries[0] = table.entries[1] = leaf;
+        return table;
+    }
+
+    vector<FlatDecodeFill> stack;
+    stack.push_back({tree.root, 0, 0, 0, bits});
+    while (!stack.empty())
+    {
+        FlatDecodeFill top = stack.back();
+        stack.pop_back();
+        const typename BasicFlatHuffmanTree<Symbol, Count>::Node& node = tree.nodes[top.node];
+        if (node.left < 0)
+        {
+            //a leaf owns every index that starts with its code
+            uint32_t start = top.code << (top.bits - top.depth);
+            uint32_t span = 1u << (top.bits - top.depth);
+            DecodeEntry leaf = {symbolValue(node.character), (uint8_t)top.depth, 0};
+            for (uint32_t i = 0; i < span; i++)
+            {
+                table.entries[top.offset + start + i] = leaf;
+            }
+            continue;
+        }
+        if (top.depth == top.bits)
+        {
+            //the code is longer than this level, link a sub table sized to the remaining subtree
+            int width = height[top.node] < primaryBits ? height[top.node] : primaryBits;
+            uint32_t subOffset = table.entries.size();
+            table.entries.resize(subOffset + (1u << width));
+            DecodeEntry link = {subOffset, 0, (uint8_t)width};
+            table.entries[top.offset + top.code] = link;
+            stack.push_back({top.node, 0, 0, subOffset, width});
+            continue;
+        }
+        //left edge is 0, right edge is 1
+        stack.push_back({node.right, (top.code << 1) | 1, top.depth + 1, top.offset, top.bits});
+        stack.push_back({node.left, top.code << 1, top.depth + 1, top.offset, top.bits});
+    }
+    return table;
+}
+
+//Helper function to walk the flat tree and determine the character of a binary code
+template <typename Symbol, typename Count>
+Symbol getChar(const BasicFlatHuffmanTree<Symbol, Count>& tree, const string& binaryCode)
+{
+    int32_t current = tree.root;
+    size_t pos = 0;
+    //a code longer than the path to the leaf stops at the leaf, the extra bits are ignored
+    for (; pos < binaryCode.size() && tree.nodes[current].left >= 0; pos++)
+    {
+        current = binaryCode[pos] == '0' ? tree.nodes[current].left : tree.nodes[current].right; //left on 0, right on 1.
+    }
+    TRACE_COUNT(TRACE_NODES_VISITED, pos);
+    return tree.nodes[current].character;
+}
+
+//Counterpart of getChar for a code of length bits packed MSB first in bytes
+template <typename Symbol, typename Count>
+Symbol getCharPacked(const BasicFlatHuffmanTree<Symbol, Count>& tree, const unsigned char* code, size_t length)
+{
+    int32_t current = tree.root;
+    size_t pos = 0;
+    for (; pos < length && tree.nodes[current].left >= 0; pos++)
+    {
+        bool bit = (code[pos >> 3] >> (7 - (pos & 7))) & 1;
+        current = bit ? tree.nodes[current].right : tree.nodes[current].left; //left on 0, right on 1.
+    }
+    TRACE_COUNT(TRACE_NODES_VISITED, pos);
+    return tree.nodes[current].character;
+}
+
+//helper function to print the symbol, frequency, and code of target to out, arr holds the code of the current path
+template <typename Symbol, typename Count>
+void traverse(const BasicFlatHuffmanTree<Symbol, Count>& tree, int32_t node, Symbol target, int arr[], int pos, ostream& out = cout)
+{
+    const BasicFlatHuffmanNode<Symbol, Count>& current = tree.nodes[node];
+    if (current.left >= 0)
+    {
+        arr[pos] = 0;
+        traverse(tree, current.left, target, arr, pos + 1, out);
+        arr[pos] = 1;
+        traverse(tree, current.right, target, arr, pos + 1, out);
+        return;
+    }
+    if (current.character == target)
+    {
+        string symbol;
+        appendSymbol(symbol, current.character);
+        out << "Symbol: " << symbol << ", Frequency: " << current.frequency << ", Code: ";
+        for (int i = 0; i < pos; i++)
+        {
+            out << arr[i];
+        }
+        out << endl;
+    }
+}
+
+//code, length and frequency of every leaf, built once so a report line costs O(1) lookups instead of a tree search
+template <typename Symbol>
+struct BasicFlatCodeTable
+{
+    SymbolIndex<Symbol> leafOf; //leaf of every symbol, -1 for symbols that are not in the tree
+    vector<int32_t> order; //leaves from left to right, which is increasing code order
+    vector<size_t> start;  //where the code of every leaf starts in codes, by leaf index
+    vector<int> length;    //code length of every leaf, by leaf index
+    string codes;          //the code of every leaf as '0'/'1' characters, one after the other
+};
+
+typedef BasicFlatCodeTable<char> FlatCodeTable;
+
+//Function to build the code table in a single walk of the tree. The walk keeps the code of the current path, so
+//codes of any length are supported and every leaf costs its code length.
+template <typename Symbol, typename Count>
+void buildFlatCodeTable(const BasicFlatHuffmanTree<Symbol, Count>& tree, BasicFlatCodeTable<Symbol>& table)
+{
+    table.leafOf.clear();
+    size_t leaves = (tree.nodes.size() + 1) / 2; //the leaves are the first nodes of the array
+    table.order.clear();
+    table.start.assign(leaves, 0);
+    table.length.assign(leaves, 0);
+    table.codes.clear();
+    if (tree.nodes.empty())
+    {
+        return;
+    }
+
+    struct Pending
+    {
+        int32_t node;
+        int depth; //length of the code of node
+        char bit;  //last bit of the code of node, unused for the root
+    };
+    vector<Pending> stack;
+    string path;
+    stack.push_back({tree.root, 0, 0});
+    while (!stack.empty())
+    {
+        Pending top = stack.back();
+        stack.pop_back();
+        path.resize(top.depth);
+        if (top.depth > 0)
+        {
+            path[top.depth - 1] = top.bit;
+        }
+        const BasicFlatHuffmanNode<Symbol, Count>& node = tree.nodes[top.node];
+        if (node.left < 0)
+        {
+            table.leafOf.set(node.character, top.node);
+            table.order.push_back(top.node);
+            table.start[top.node] = table.codes.size();
+            table.length[top.node] = top.depth;
+            table.codes += path;
+            continue;
+        }
+        //left edge is 0, right edge is 1, the left subtree is visited first
+        stack.push_back({node.right, top.depth + 1, '1'});
+        stack.push_back({node.left, top.depth + 1, '0'});
+    }
+}
+
+//Function to append the symbol, frequency, and code line of leaf to out
+template <typename Symbol, typename Count>
+void appendCodeLine(string& out, const BasicFlatHuffmanTree<Symbol, Count>& tree, const BasicFlatCodeTable<Symbol>& table, int32_t leaf)
+{
+    out += "Symbol: ";
+    appendSymbol(out, tree.nodes[leaf].character);
+    out += ", Frequency: ";
+    out += to_string(tree.nodes[leaf].frequency);
+    out += ", Code: ";
+    out.append(table.codes, table.start[leaf], table.length[leaf]);
+    out += '\n';
+}
+
+//print result from generating the flat tree, every leaf from left to right
+template <typename Symbol, typename Count>
+void encode(const BasicFlatHuffmanTree<Symbol, Count>& tree)
+{
+    BasicFlatCodeTable<Symbol> table;
+    buildFlatCodeTable(tree, table);
+    string lines;
+    for (int32_t leaf : table.order)
+    {
+        appendCodeLine(lines, tree, table, leaf);
+    }
+    cout << lines;
+}
+
+//Function to decode with the selected engine, walking the flat tree for DECODE_TREE
+template <typename Symbol, typename Count>
+Symbol decodeChar(DecodeMode mode, const BasicFlatHuffmanTree<Symbol, Count>& tree, const HuffmanDecodeTable* table, const string& binaryCode)
+{
+    TRACE_COUNT(TRACE_CODES_DECODED, 1);
+    TRACE_COUNT(TRACE_BITS_DECODED, binaryCode.size());
+    if (mode == DECODE_TABLE && table)
+    {
+        return (Symbol)decodeTableSymbol(*table, binaryCode);
+    }
+    return getChar(tree, binaryCode);
+}
+
+//Function to decode a packed code with the selected engine
+template <typename Symbol, typename Count>
+Symbol decodeCharPacked(DecodeMode mode, const BasicFlatHuffmanTree<Symbol, Count>& tree, const HuffmanDecodeTable* table, const unsigned char* code, size_t length)
+{
+    TRACE_COUNT(TRACE_CODES_DECODED, 1);
+    TRACE_COUNT(TRACE_BITS_DECODED, length);
+    if (mode == DECODE_TABLE && table)
+    {
+        return (Symbol)decodeTablePackedSymbol(*table, code, length);
+    }
+    return getCharPacked(tree, code, length);
+}
+
+#endif
@@ -0,0 +1,526 @@
+// Packed bitstream container for compressed messages.
+// Replaces the text format (one ASCII binary code per symbol followed by decimal positions) with a compact
+// header and the codes of the message packed back to back, most significant bit first.
+//
+// Layout, integers are little endian:
+//   magic    4 bytes  0x89 'H' 'U' 'F'
+//   version  1 byte   HUFFMAN_STREAM_VERSION
+//   flags    1 byte   STREAM_FLAG_CANONICAL: codes are canonical codes of the Huffman code lengths
+//                     STREAM_FLAG_LIMITED: with STREAM_FLAG_CANONICAL, the code lengths are limited (package-merge)
+//   max      1 byte   longest code length, only present with STREAM_FLAG_LIMITED
+//   n        2 bytes  number of symbols in the alphabet
+//   n times  1 byte symbol, varint frequency (same order as the alphabet input, it decides ties)
+//   varint   number of symbols in the message
+//   with STREAM_FLAG_BLOCKS only:
+//     varint   symbols per block, every block but the last one holds that many
+//     varint   number of blocks k
+//     k times  varint size of the block in bytes, the index that lets every block be decoded on its own
+//   payload  packed codes, the last byte is padded with zero bits. With STREAM_FLAG_BLOCKS every block is a
+//            payload of its own, padded to a whole byte, and the blocks follow each other
+#ifndef HUFFMANSTREAM_H
+#define HUFFMANSTREAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "huffmanTree.h"
+#include "huffmanTable.h"
+#include "huffmanFlatTree.h"
+#include "huffmanCanonical.h"
+
+const unsigned char HUFFMAN_STREAM_MAGIC[4] = {0x89, 'H', 'U', 'F'};
+const int HUFFMAN_STREAM_VERSION = 1;
+const int STREAM_FLAG_CANONICAL = 1;
+const int STREAM_FLAG_LIMITED = 2;
+const int STREAM_FLAG_BLOCKS = 4;
+
+//number of symbols decoded between two writes when a message is streamed to its output
+const size_t DECODE_WINDOW = 1 << 20;
+
+//most symbols in one block of a blocked container, a window then holds at least 64 blocks to decode in parallel
+const uint64_t MAX_BLOCK_SYMBOLS = DECODE_WINDOW / 64;
+
+//alphabet and message size read from the container header
+struct StreamHeader
+{
+    int version;
+    int flags;
+    int maxLength; //longest code length with STREAM_FLAG_LIMITED, 0 otherwise
+    vector<char> symbols;
+    vector<int> frequencies;
+    uint64_t messageLength;
+    uint64_t blockSymbols;       //symbols per block with STREAM_FLAG_BLOCKS, 0 for a single payload
+    vector<uint64_t> blockBytes; //size of every block in bytes
+};
+
+//Reads a container sequentially from an input stream in large blocks.
+//The header is read byte by byte, the payload through a 64 bit buffer whose next bit is the most significant one.
+class BitReader
+{
+public:
+    uint64_t buffer; //pending bits, left aligned
+    int count;       //number of valid bits in buffer
+
+    uint64_t blockSymbols; //symbols per payload block of a blocked container, 0 for a single payload
+    uint64_t blockLeft;    //symbols left in the current payload block
+
+    BitReader(istream& input, size_t blockSize = 1 << 16) : buffer(0), count(0), blockSymbols(0), blockLeft(0), in(input), block(blockSize), pos(0), end(0), filled(0), exhausted(false), padding(0) {}
+
+    //read one byte, -1 at the end of the input. Only valid before the payload bits are used.
+    int readByte()
+    {
+        if (pos == end && !fill())
+        {
+            return -1;
+        }
+        return block[pos++];
+    }
+
+    //read an unsigned LEB128 integer, false if the input ends in the middle
+    bool readVarint(uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = readByte();
+            if (byte < 0)
+            {
+                return false;
+            }
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //top up buffer to at least 56 bits. Past the end of the input the reader supplies zero bits.
+    void refill()
+    {
+        while (count <= 56)
+        {
+            if (pos == end && !fill())
+            {
+                //the padding is never decoded as a symbol because the message length is known, unless the input
+                //is cut short: the zero bits supplied are counted so overran() can tell
+                padding += 64 - count;
+                count = 64;
+                return;
+            }
+            if (end - pos >= 8)
+            {
+                //fast path, load a big endian word and keep the whole bytes that fit
+                uint64_t word;
+                memcpy(&word, &block[pos], 8);
+                buffer |= __builtin_bswap64(word) >> count;
+                int bytes = (63 - count) >> 3;
+                pos += bytes;
+                count += bytes * 8;
+                return;
+            }
+            buffer |= (uint64_t)block[pos++] << (56 - count);
+            count += 8;
+        }
+    }
+
+    //peek at the next bits (1..32), buffer has to hold them
+    uint32_t peek(int bits) const
+    {
+        return (uint32_t)(buffer >> (64 - bits));
+    }
+
+    //drop bits from the front of the buffer
+    void consume(int bits)
+    {
+        buffer = bits < 64 ? buffer << bits : 0;
+        count -= bits;
+    }
+
+    //drop the padding bits up to the next byte boundary, where the next payload block starts
+    void alignToByte()
+    {
+        consume(count & 7); //whole bytes are loaded, so the bits of a partly used byte are the count % 8 first ones
+    }
+
+    bool atEnd() const
+    {
+        return exhausted && pos == end;
+    }
+
+    //true once a bit past the end of the input was consumed, the payload was shorter than its message
+    bool overran() const
+    {
+        //the supplied zero bits are the last ones of the buffer, the first count bits are still there
+        return padding > (uint64_t)count;
+    }
+
+    //number of bytes read from the input so far. Only valid before the payload bits are used.
+    uint64_t offset() const
+    {
+        return filled - (end - pos);
+    }
+
+private:
+    istream& in;
+    vector<unsigned char> block;
+    size_t pos, end;
+    uint64_t filled; //bytes loaded from the input
+    bool exhausted;
+    uint64_t padding; //zero bits supplied past the end of the input
+
+    //load the next block of the input
+    bool fill()
+    {
+        if (exhausted)
+        {
+            return false;
+        }
+        in.read((char*)block.data(), block.size());
+        pos = 0;
+        end = in.gcount();
+        filled += end;
+        if (end < block.size())
+        {
+            exhausted = true;
+        }
+        return end > 0;
+    }
+};
+
+//Stream buffer over bytes already in memory, so a container received in one piece is read by a BitReader
+//without being copied into a string stream first
+class MemoryStreamBuffer : public streambuf
+{
+public:
+    MemoryStreamBuffer(const char* data, size_t size)
+    {
+        char* begin = const_cast<char*>(data); //only read through the get area
+        setg(begin, begin, begin + size);
+    }
+};
+
+//check whether the next bytes of the stream are a packed container, without consuming anything
+bool isPackedStream(istream& in)
+{
+    return in.peek() == HUFFMAN_STREAM_MAGIC[0];
+}
+
+//Function to read the container header, false if the input is not a valid container.
+bool readStreamHeader(BitReader& reader, StreamHeader& header)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (reader.readByte() != HUFFMAN_STREAM_MAGIC[i])
+        {
+            return false;
+        }
+    }
+    header.version = reader.readByte();
+    header.flags = reader.readByte();
+    if (header.version != HUFFMAN_STREAM_VERSION || header.flags < 0 || (header.flags & ~(STREAM_FLAG_CANONICAL | STREAM_FLAG_LIMITED | STREAM_FLAG_BLOCKS)))
+    {
+        return false;
+    }
+    header.maxLength = 0;
+    if (header.flags & STREAM_FLAG_LIMITED)
+    {
+        //only canonical codes can be length limited, the tree fixes the tree codes
+        header.maxLength = reader.readByte();
+        if (!(header.flags & STREAM_FLAG_CANONICAL) || header.maxLength < 1 || header.maxLength > MAX_CODE_LENGTH)
+        {
+            return false;
+        }
+    }
+    int low = reader.readByte();
+    int high = reader.readByte();
+    if (low < 0 || high < 0)
+    {
+        return false;
+    }
+    int n = low | (high << 8);
+    if (n == 0 || n > 256)
+    {
+        return false; //the symbols are bytes, n only takes two bytes because 256 does not fit in one
+    }
+    header.symbols.resize(n);
+    header.frequencies.resize(n);
+    uint64_t total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int symbol = reader.readByte();
+        uint64_t frequency;
+        if (symbol < 0 || !reader.readVarint(frequency))
+        {
+            return false;
+        }
+        //the tree adds the frequencies up as int, compress keeps the message within 0x7fffffff bytes for that
+        total += frequency;
+        if (frequency > 0x7fffffff || total > 0x7fffffff)
+        {
+            return false;
+        }
+        header.symbols[i] = (char)symbol;
+        header.frequencies[i] = (int)frequency;
+    }
+    //the frequencies are the counts of the symbols in the message
+    if (!reader.readVarint(header.messageLength) || header.messageLength != total)
+    {
+        return false;
+    }
+    header.blockSymbols = 0;
+    header.blockBytes.clear();
+    if (header.flags & STREAM_FLAG_BLOCKS)
+    {
+        uint64_t blocks;
+        if (!reader.readVarint(header.blockSymbols) || !reader.readVarint(blocks) || header.blockSymbols == 0 || header.blockSymbols > MAX_BLOCK_SYMBOLS)
+        {
+            return false;
+        }
+        if (blocks != (header.messageLength + header.blockSymbols - 1) / header.blockSymbols)
+        {
+            return false;
+        }
+        //every block size takes at least one byte of the input, so the index only grows with what is read and
+        //a header announcing more blocks than its input holds fails without allocating them first
+        header.blockBytes.reserve(blocks < 4096 ? blocks : 4096);
+        for (uint64_t b = 0; b < blocks; b++)
+        {
+            uint64_t bytes;
+            if (!reader.readVarint(bytes))
+            {
+                return false;
+            }
+            header.blockBytes.push_back(bytes);
+        }
+        reader.blockSymbols = header.blockSymbols;
+        reader.blockLeft = header.blockSymbols;
+    }
+    return true;
+}
+
+//Function to build the Huffman Tree described by the container header
+void buildStreamTree(StreamHeader& header, FlatHuffmanTree& tree)
+{
+    buildFlatHuffmanTree(header.symbols.data(), header.frequencies.data(), header.symbols.size(), tree);
+}
+
+//Function to decode count symbols from the payload into out using the decode tables.
+//While the longest code fits in the bit buffer a symbol costs one lookup per table level and no refill.
+void decodePayload(BitReader& reader, const HuffmanDecodeTable& table, char* out, uint64_t count)
+{
+    uint64_t i = 0;
+    while (i < count)
+    {
+        reader.refill();
+        if (table.maxLength <= reader.count)
+        {
+            //fast path, every code is already in the buffer
+            do
+            {
+                int length;
+                out[i++] = (char)decodeWindow(table, reader.buffer, length);
+                reader.consume(length);
+            } while (i < count && table.maxLength <= reader.count);
+            continue;
+        }
+
+        //slow path for codes longer than the buffer, refill between table levels
+        int bits = table.rootBits;
+        DecodeEntry entry = table.entries[reader.peek(bits)];
+        while (entry.subBits)
+        {
+            reader.consume(bits);
+            reader.refill();
+            bits = entry.subBits;
+            entry = table.entries[entry.value + reader.peek(bits)];
+        }
+        reader.consume(entry.length);
+        out[i++] = (char)entry.value;
+    }
+}
+
+//Tree walk counterpart of decodePayload: follow one child index per bit from the root.
+void decodePayloadTree(BitReader& reader, const FlatHuffmanTree& tree, char* out, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        int32_t current = tree.root;
+        while (tree.nodes[current].left >= 0)
+        {
+            if (reader.count == 0)
+            {
+                reader.refill();
+            }
+            current = reader.peek(1) ? tree.nodes[current].right : tree.nodes[current].left; //travel right on 1, left on 0.
+            reader.consume(1);
+        }
+        out[i] = tree.nodes[current].character;
+    }
+}
+
+//Canonical counterpart of decodePayloadTree: one bit at a time against the length counts.
+void decodePayloadCanonical(BitReader& reader, const CanonicalCode& code, char* out, uint64_t count)
+{
+    auto nextBit = [&]() {
+        if (reader.count == 0)
+        {
+            reader.refill();
+        }
+        uint32_t bit = reader.peek(1);
+        reader.consume(1);
+        return bit;
+    };
+    for (uint64_t i = 0; i < count; i++)
+    {
+        out[i] = (char)decodeCanonicalSymbol(code, nextBit);
+    }
+}
+
+//decoder state derived from a container header
+struct StreamCodec
+{
+    bool isCanonical;         //canonical codes instead of the tree codes
+    FlatHuffmanTree tree;     //Huffman Tree, empty for canonical codes
+    CanonicalCode canonical;  //length counts and symbols, used for canonical codes
+    HuffmanDecodeTable table; //multi-bit decode tables for either kind of code
+};
+
+//Function to prepare the decoder for the codes the header describes, false if they cannot be represented
+bool prepareStreamCodec(StreamHeader& header, StreamCodec& codec)
+{
+    if (!(header.flags & STREAM_FLAG_CANONICAL))
+    {
+        codec.isCanonical = false;
+        buildStreamTree(header, codec.tree);
+        codec.table = buildDecodeTable(codec.tree);
+        return true;
+    }
+    codec.isCanonical = true;
+    vector<int> lengths;
+    if (!computeLimitedCodeLengths(header.symbols.data(), header.frequencies.data(), header.symbols.size(), header.maxLength, lengths))
+    {
+        return false;
+    }
+    if (!buildCanonicalCode(header.symbols.data(), lengths, header.symbols.size(), codec.canonical))
+    {
+        return false;
+    }
+    codec.table = buildDecodeTable(canonicalCodes(codec.canonical));
+    return true;
+}
+
+//Function to decode count symbols of one payload with the selected engine.
+//DECODE_TREE walks the tree bit by bit, or the length counts for canonical codes.
+void decodeSingleStream(BitReader& reader, const StreamCodec& codec, DecodeMode mode, char* out, uint64_t count)
+{
+    if (mode == DECODE_TABLE)
+    {
+        decodePayload(reader, codec.table, out, count);
+    }
+    else if (!codec.isCanonical)
+    {
+        decodePayloadTree(reader, codec.tree, out, count);
+    }
+    else
+    {
+        decodePayloadCanonical(reader, codec.canonical, out, count);
+    }
+}
+
+//Function to decode the next count symbols of the payload with the selected engine. The payload blocks of a
+//blocked container are decoded one after the other, skipping the padding between them.
+void decodeStream(BitReader& reader, const StreamCodec& codec, DecodeMode mode, char* out, uint64_t count)
+{
+    TRACE_COUNT(TRACE_CODES_DECODED, count);
+    if (reader.blockSymbols == 0)
+    {
+        decodeSingleStream(reader, codec, mode, out, count);
+        return;
+    }
+    while (count > 0)
+    {
+        if (reader.blockLeft == 0)
+        {
+            reader.alignToByte();
+            reader.blockLeft = reader.blockSymbols;
+        }
+        uint64_t n = count < reader.blockLeft ? count : reader.blockLeft;
+        decodeSingleStream(reader, codec, mode, out, n);
+        out += n;
+        count -= n;
+        reader.blockLeft -= n;
+    }
+}
+
+//Function to decode count symbols of the payload with the selected engine and write them to out one window at a
+//time. Only one window is held in memory, however long the message is. False if the payload ran out before count
+//symbols, the symbols past its end are written as decoded from zero bits.
+bool decodeStreamTo(BitReader& reader, const StreamCodec& codec, DecodeMode mode, ostream& out, uint64_t count, size_t window = DECODE_WINDOW)
+{
+    vector<char> buffer(count < window ? count : window);
+    while (count > 0)
+    {
+        size_t n = count < window ? count : window;
+        decodeStream(reader, codec, mode, buffer.data(), n);
+        out.write(buffer.data(), n);
+        count -= n;
+    }
+    return !reader.overran();
+}
+
+//Function to print the symbol, frequency, and code of every symbol of the header in header order.
+//The codes are looked up by symbol, one table is built for all of them.
+void printStreamCodes(StreamHeader& header, const StreamCodec& codec)
+{
+    string lines;
+    if (!codec.isCanonical)
+    {
+        FlatCodeTable table;
+        buildFlatCodeTable(codec.tree, table);
+        for (size_t i = 0; i < header.symbols.size(); i++)
+        {
+            int32_t leaf = table.leafOf[header.symbols[i]];
+            if (leaf >= 0)
+            {
+                appendCodeLine(lines, codec.tree, table, leaf);
+            }
+        }
+        cout << lines;
+        return;
+    }
+    vector<SymbolCode> codes = canonicalCodes(codec.canonical);
+    int codeOf[256];
+    for (int s = 0; s < 256; s++)
+    {
+        codeOf[s] = -1;
+    }
+    for (size_t c = 0; c < codes.size(); c++)
+    {
+        codeOf[codes[c].symbol & 0xff] = c;
+    }
+    for (size_t i = 0; i < header.symbols.size(); i++)
+    {
+        int c = codeOf[(unsigned char)header.symbols[i]];
+        if (c < 0)
+        {
+            continue;
+        }
+        lines += "Symbol: ";
+        lines += header.symbols[i];
+        lines += ", Frequency: " + to_string(header.frequencies[i]) + ", Code: ";
+        for (int b = codes[c].length - 1; b >= 0; b--)
+        {
+            lines += (char)('0' + ((codes[c].bits >> b) & 1));
+        }
+        lines += '\n';
+    }
+    cout << lines;
+}
+
+#endif
@@ -0,0 +1,146 @@
+// Symbol types of the Huffman Trees.
+// The trees and decoders are templates over the type of a symbol and the type of its frequency. The assignments use
+// one byte symbols (char), large alphabets such as tokens or Unicode code points use uint16_t or uint32_t symbols,
+// and counts that do not fit in an int use uint64_t. The helpers below are chosen at compile time from the symbol
+// type, so byte symbols keep their 256 entry lookup arrays while wider symbols get a table or a hash map instead.
+#ifndef HUFFMANSYMBOL_H
+#define HUFFMANSYMBOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+//value of a symbol in the decode tables and the code lists, a char is taken as unsigned
+template <typename Symbol>
+inline uint32_t symbolValue(Symbol symbol)
+{
+    return (uint32_t)(typename std::make_unsigned<Symbol>::type)symbol;
+}
+
+//order of symbols of equal frequency in Compare, the ASCII value of a char is signed like before
+template <typename Symbol>
+inline long long symbolRank(Symbol symbol)
+{
+    return (long long)symbol;
+}
+
+//append a symbol to a report line: bytes as they are, wider symbols as the UTF-8 encoding of their code point
+inline void appendSymbol(std::string& out, char symbol)
+{
+    out += symbol;
+}
+
+inline void appendSymbol(std::string& out, unsigned char symbol)
+{
+    out += (char)symbol;
+}
+
+template <typename Symbol>
+void appendSymbol(std::string& out, Symbol symbol)
+{
+    uint32_t point = symbolValue(symbol);
+    if (point < 0x80)
+    {
+        out += (char)point;
+    }
+    else if (point < 0x800)
+    {
+        out += (char)(0xC0 | (point >> 6));
+        out += (char)(0x80 | (point & 0x3F));
+    }
+    else if (point < 0x10000)
+    {
+        out += (char)(0xE0 | (point >> 12));
+        out += (char)(0x80 | ((point >> 6) & 0x3F));
+        out += (char)(0x80 | (point & 0x3F));
+    }
+    else
+    {
+        out += (char)(0xF0 | ((point >> 18) & 0x07));
+        out += (char)(0x80 | ((point >> 12) & 0x3F));
+        out += (char)(0x80 | ((point >> 6) & 0x3F));
+        out += (char)(0x80 | (point & 0x3F));
+    }
+}
+
+//Index from a symbol to a node of the tree, -1 for symbols that are not in it.
+//32 bit symbols are sparse, they are kept in a hash map.
+template <typename Symbol, size_t Bytes = sizeof(Symbol)>
+class SymbolIndex
+{
+public:
+    void clear()
+    {
+        nodes.clear();
+    }
+
+    void set(Symbol symbol, int32_t node)
+    {
+        nodes[symbol] = node;
+    }
+
+    int32_t operator[](Symbol symbol) const
+    {
+        auto found = nodes.find(symbol);
+        return found == nodes.end() ? -1 : found->second;
+    }
+
+private:
+    std::unordered_map<Symbol, int32_t> nodes;
+};
+
+//byte symbols index a fixed array of every byte value
+template <typename Symbol>
+class SymbolIndex<Symbol, 1>
+{
+public:
+    void clear()
+    {
+        for (int32_t& node : nodes)
+        {
+            node = -1;
+        }
+    }
+
+    void set(Symbol symbol, int32_t node)
+    {
+        nodes[symbolValue(symbol)] = node;
+    }
+
+    int32_t operator[](Symbol symbol) const
+    {
+        return nodes[symbolValue(symbol)];
+    }
+
+private:
+    int32_t nodes[256];
+};
+
+//16 bit symbols index an array of every value, allocated once
+template <typename Symbol>
+class SymbolIndex<Symbol, 2>
+{
+public:
+    void clear()
+    {
+        nodes.assign(65536, -1);
+    }
+
+    void set(Symbol symbol, int32_t node)
+    {
+        nodes[symbolValue(symbol)] = node;
+    }
+
+    int32_t operator[](Symbol symbol) const
+    {
+        return nodes[symbolValue(symbol)];
+    }
+
+private:
+    std::vector<int32_t> nodes;
+};
+
+#endif
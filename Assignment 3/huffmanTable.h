@@ -0,0 +1,295 @@
+// Table-driven decoder for the Huffman Tree.
+// Instead of chasing one pointer per bit from the root (getChar), the tree is flattened once into lookup tables
+// that resolve several bits per access. Codes longer than the first table fall back to linked sub tables.
+#ifndef HUFFMANTABLE_H
+#define HUFFMANTABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "huffmanTree.h"
+
+//number of bits resolved by the first lookup when the tree is deep enough to need them
+const int DEFAULT_PRIMARY_BITS = 10;
+
+//select which engine turns a binary code back into a symbol
+enum DecodeMode
+{
+    DECODE_TREE,  //walk the pointer tree one bit at a time (getChar)
+    DECODE_TABLE  //multi-bit lookup tables (decodeTableChar)
+};
+
+//Entry of a decode table.
+//A symbol entry stores the symbol in value and the number of bits of the code resolved at this level in length.
+//A link entry has subBits > 0, value is the offset of the next table and subBits its index width.
+struct DecodeEntry
+{
+    uint32_t value;
+    uint8_t length;
+    uint8_t subBits;
+};
+
+//All levels are stored in one vector, the first table starts at offset 0.
+struct HuffmanDecodeTable
+{
+    std::vector<DecodeEntry> entries;
+    int rootBits;  //index width of the first table
+    int maxLength; //length of the longest code in the tree
+};
+
+//helper function to fill the table of width bits starting at offset with the subtree below node.
+//code holds the depth bits already consumed inside this table.
+template <typename Symbol, typename Count>
+void fillDecodeTable(HuffmanDecodeTable& table, BasicHuffmanTreeNode<Symbol, Count>* node, uint32_t code, int depth, uint32_t offset, int bits, int subBits)
+{
+    if (!node->left && !node->right)
+    {
+        //a leaf owns every index that starts with its code
+        uint32_t start = code << (bits - depth);
+        uint32_t span = 1u << (bits - depth);
+        DecodeEntry leaf = {symbolValue(node->character), (uint8_t)depth, 0};
+        for (uint32_t i = 0; i < span; i++)
+        {
+            table.entries[offset + start + i] = leaf;
+        }
+        return;
+    }
+
+    if (depth == bits)
+    {
+        //the code is longer than this level, link a sub table sized to the remaining subtree
+        int height = treeHeight(node);
+        int width = height < subBits ? height : subBits;
+        uint32_t subOffset = table.entries.size();
+        table.entries.resize(subOffset + (1u << width));
+        DecodeEntry link = {subOffset, 0, (uint8_t)width};
+        table.entries[offset + code] = link;
+        fillDecodeTable(table, node, 0, 0, subOffset, width, subBits);
+        return;
+    }
+
+    //left edge is 0, right edge is 1
+    fillDecodeTable(table, node->left, code << 1, depth + 1, offset, bits, subBits);
+    fillDecodeTable(table, node->right, (code << 1) | 1, depth + 1, offset, bits, subBits);
+}
+
+//Function to build the decode tables from the Huffman Tree.
+//primaryBits is clamped to the tree height so small alphabets get a small first table.
+template <typename Symbol, typename Count>
+HuffmanDecodeTable buildDecodeTable(BasicHuffmanTreeNode<Symbol, Count>* root, int primaryBits = DEFAULT_PRIMARY_BITS)
+{
+    HuffmanDecodeTable table;
+    table.maxLength = treeHeight(root);
+
+    //a tree with a single leaf has the empty code, give it a one bit table whose entries consume nothing
+    int bits = table.maxLength < primaryBits ? table.maxLength : primaryBits;
+    table.rootBits = bits > 0 ? bits : 1;
+    table.entries.resize(1u << table.rootBits);
+    if (bits == 0)
+    {
+        DecodeEntry leaf = {symbolValue(root->character), 0, 0};
+        table.entries[0] = table.entries[1] = leaf;
+        return table;
+    }
+    fillDecodeTable(table, root, 0, 0, 0, bits, primaryBits);
+    return table;
+}
+
+//code of one symbol, right aligned in bits
+struct SymbolCode
+{
+    uint32_t symbol;
+    uint64_t bits;
+    int length;
+};
+
+//the low bits of a code below the consumed prefix
+inline uint64_t codeSuffix(const SymbolCode& code, int consumed)
+{
+    int rest = code.length - consumed;
+    return rest >= 64 ? code.bits : code.bits & ((1ull << rest) - 1);
+}
+
+//helper function to fill the table of width bits starting at offset with codes[lo, hi).
+//The codes share a prefix of consumed bits and are sorted by their left aligned value, so codes
+//sharing a longer prefix are next to each other.
+void fillDecodeTableCodes(HuffmanDecodeTable& table, const vector<SymbolCode>& codes, size_t lo, size_t hi, int consumed, uint32_t offset, int bits, int subBits)
+{
+    size_t i = lo;
+    while (i < hi)
+    {
+        int rest = codes[i].length - consumed;
+        uint64_t suffix = codeSuffix(codes[i], consumed);
+        if (rest <= bits)
+        {
+            //the code ends in this table, it owns every index that starts with it
+            uint32_t start = (uint32_t)suffix << (bits - rest);
+            uint32_t span = 1u << (bits - rest);
+            DecodeEntry leaf = {codes[i].symbol, (uint8_t)rest, 0};
+            for (uint32_t k = 0; k < span; k++)
+            {
+                table.entries[offset + start + k] = leaf;
+            }
+            i++;
+            continue;
+        }
+
+        //the code continues below this table, group every code with the same index into one sub table
+        uint32_t index = (uint32_t)(suffix >> (rest - bits));
+        size_t j = i;
+        int longest = 0;
+        while (j < hi && codes[j].length - consumed > bits && (uint32_t)(codeSuffix(codes[j], consumed) >> (codes[j].length - consumed - bits)) == index)
+        {
+            longest = codes[j].length - consumed > longest ? codes[j].length - consumed : longest;
+            j++;
+        }
+        int width = longest - bits < subBits ? longest - bits : subBits;
+        uint32_t subOffset = table.entries.size();
+        table.entries.resize(subOffset + (1u << width));
+        DecodeEntry link = {subOffset, 0, (uint8_t)width};
+        table.entries[offset + index] = link;
+        fillDecodeTableCodes(table, codes, i, j, consumed + bits, subOffset, width, subBits);
+        i = j;
+    }
+}
+
+//Function to build the decode tables from a list of codes instead of a tree (canonical codes).
+//codes has to be sorted by left aligned code value, as canonical codes and a left to right tree walk are.
+HuffmanDecodeTable buildDecodeTable(const vector<SymbolCode>& codes, int primaryBits = DEFAULT_PRIMARY_BITS)
+{
+    HuffmanDecodeTable table;
+    table.maxLength = 0;
+    for (const SymbolCode& code : codes)
+    {
+        table.maxLength = code.length > table.maxLength ? code.length : table.maxLength;
+    }
+
+    int bits = table.maxLength < primaryBits ? table.maxLength : primaryBits;
+    table.rootBits = bits > 0 ? bits : 1;
+    table.entries.resize(1u << table.rootBits);
+    if (bits == 0)
+    {
+        //single symbol with the empty code
+        DecodeEntry leaf = {codes[0].symbol, 0, 0};
+        table.entries[0] = table.entries[1] = leaf;
+        return table;
+    }
+    fillDecodeTableCodes(table, codes, 0, codes.size(), 0, 0, bits, primaryBits);
+    return table;
+}
+
+//Function to find a lower bound of the shortest code length: the length of the shortest code resolved by the first
+//table, or its width when every entry links to a sub table. 0 for the empty code of a single symbol.
+int shortestCodeLength(const HuffmanDecodeTable& table)
+{
+    int shortest = table.rootBits;
+    for (size_t i = 0; i < (1u << table.rootBits); i++)
+    {
+        const DecodeEntry& entry = table.entries[i];
+        if (!entry.subBits && entry.length < shortest)
+        {
+            shortest = entry.length;
+        }
+    }
+    return shortest;
+}
+
+//Decode one symbol from the front of window, the next bit of the stream being the most significant bit.
+//length receives the number of bits of the code. Codes have to fit in the 64 bit window.
+inline uint32_t decodeWindow(const HuffmanDecodeTable& table, uint64_t window, int& length)
+{
+    int bits = table.rootBits;
+    int used = 0;
+    DecodeEntry entry = table.entries[window >> (64 - bits)];
+    while (entry.subBits)
+    {
+        used += bits;
+        window <<= bits;
+        bits = entry.subBits;
+        entry = table.entries[entry.value + (window >> (64 - bits))];
+    }
+    length = used + entry.length;
+    return entry.value;
+}
+
+//Table counterpart of getChar: determine the symbol value of a binary code written as '0'/'1' characters.
+uint32_t decodeTableSymbol(const HuffmanDecodeTable& table, const string& binaryCode)
+{
+    size_t pos = 0;
+    uint32_t offset = 0;
+    int bits = table.rootBits;
+    while (true)
+    {
+        //gather the next bits of the code, missing bits past the end are zero
+        uint32_t index = 0;
+        for (int i = 0; i < bits; i++)
+        {
+            index = (index << 1) | (pos + i < binaryCode.size() && binaryCode[pos + i] == '1');
+        }
+        const DecodeEntry& entry = table.entries[offset + index];
+        if (!entry.subBits)
+        {
+            return entry.value;
+        }
+        pos += bits;
+        offset = entry.value;
+        bits = entry.subBits;
+    }
+}
+
+//Counterpart of decodeTableSymbol for a code of length bits packed MSB first in bytes, as sent over a socket
+uint32_t decodeTablePackedSymbol(const HuffmanDecodeTable& table, const unsigned char* code, size_t length)
+{
+    size_t pos = 0;
+    uint32_t offset = 0;
+    int bits = table.rootBits;
+    while (true)
+    {
+        //gather the next bits of the code, missing bits past the end are zero
+        uint32_t index = 0;
+        for (int i = 0; i < bits; i++, pos++)
+        {
+            index = (index << 1) | (pos < length && ((code[pos >> 3] >> (7 - (pos & 7))) & 1));
+        }
+        const DecodeEntry& entry = table.entries[offset + index];
+        if (!entry.subBits)
+        {
+            return entry.value;
+        }
+        offset = entry.value;
+        bits = entry.subBits;
+    }
+}
+
+//decodeTableSymbol for byte symbols
+char decodeTableChar(const HuffmanDecodeTable& table, const string& binaryCode)
+{
+    return (char)decodeTableSymbol(table, binaryCode);
+}
+
+//decodeTablePackedSymbol for byte symbols
+char decodeTablePacked(const HuffmanDecodeTable& table, const unsigned char* code, size_t length)
+{
+    return (char)decodeTablePackedSymbol(table, code, length);
+}
+
+//Read the decoder selection from the command line: --decoder=tree or --decoder=table (default).
+DecodeMode parseDecodeMode(int argc, char* argv[])
+{
+    DecodeMode mode = DECODE_TABLE;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--decoder=tree") == 0)
+        {
+            mode = DECODE_TREE;
+        }
+        else if (strcmp(argv[i], "--decoder=table") == 0)
+        {
+            mode = DECODE_TABLE;
+        }
+    }
+    return mode;
+}
+
+#endif
@@ -0,0 +1,256 @@
+// Opt-in instrumentation of the decompressors.
+// Built with HUFFMAN_TRACE defined, the TRACE_ macros record the wall and CPU time of every phase, the time every
+// thread spends waiting on a mutex or condition variable, and event counters such as the bits decoded. Each thread
+// records into its own buffer, nothing is shared on the hot path. At exit a summary is printed to stderr and, when
+// the HUFFMAN_TRACE_FILE environment variable names a file, every event is written there in the Chrome trace event
+// format (chrome://tracing or ui.perfetto.dev).
+// Without HUFFMAN_TRACE the macros expand to nothing and the decompressors are compiled exactly as before.
+#ifndef HUFFMANTRACE_H
+#define HUFFMANTRACE_H
+
+#include <cstdint>
+
+//event counters, summed over every thread
+enum TraceCounter
+{
+    TRACE_CODES_DECODED, //binary codes or packed symbols turned into a symbol
+    TRACE_BITS_DECODED,  //code bits consumed by the decoders
+    TRACE_NODES_VISITED, //tree nodes stepped through by the per bit decoders
+    TRACE_COUNTERS
+};
+
+#ifdef HUFFMAN_TRACE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+
+//one timed interval of one thread
+struct TraceEvent
+{
+    const char* name;
+    bool wait;       //a wait on a mutex or condition variable rather than a phase
+    int64_t startNs; //wall time since the trace started
+    int64_t wallNs;
+    int64_t cpuNs;   //CPU time of the thread during the interval
+};
+
+//events and counters of one thread, owned by the registry so they outlive the thread
+struct TraceThread
+{
+    int id;
+    std::vector<TraceEvent> events;
+    uint64_t counters[TRACE_COUNTERS];
+};
+
+class TraceRegistry
+{
+public:
+    static TraceRegistry& instance()
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    //buffer of the calling thread, registered on its first event
+    TraceThread& thread()
+    {
+        static thread_local TraceThread* current = nullptr;
+        if (!current)
+        {
+            current = new TraceThread();
+            for (uint64_t& counter : current->counters)
+            {
+                counter = 0;
+            }
+            pthread_mutex_lock(&mutex);
+            current->id = threads.size() + 1;
+            threads.push_back(current);
+            pthread_mutex_unlock(&mutex);
+        }
+        return *current;
+    }
+
+    int64_t wallNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static int64_t cpuNs()
+    {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec * 1000000000ll + now.tv_nsec;
+    }
+
+    //print the summary and write the trace file, the threads that recorded have to be done
+    ~TraceRegistry()
+    {
+        report();
+        const char* path = getenv("HUFFMAN_TRACE_FILE");
+        if (path && *path)
+        {
+            writeChromeTrace(path);
+        }
+        for (TraceThread* thread : threads)
+        {
+            delete thread;
+        }
+        pthread_mutex_destroy(&mutex);
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+    pthread_mutex_t mutex;
+    std::vector<TraceThread*> threads;
+
+    TraceRegistry() : start(std::chrono::steady_clock::now())
+    {
+        pthread_mutex_init(&mutex, nullptr);
+    }
+
+    void report()
+    {
+        //phases are summed over every thread by name, waits are reported per thread
+        struct Total
+        {
+            long long count;
+            int64_t wallNs;
+            int64_t cpuNs;
+        };
+        std::map<std::string, Total> phases;
+        uint64_t counters[TRACE_COUNTERS] = {};
+        fprintf(stderr, "---- trace: phases (wall ms, cpu ms, calls) ----\n");
+        for (TraceThread* thread : threads)
+        {
+            for (const TraceEvent& event : thread->events)
+            {
+                if (!event.wait)
+                {
+                    Total& total = phases[event.name];
+                    total.count++;
+                    total.wallNs += event.wallNs;
+                    total.cpuNs += event.cpuNs;
+                }
+            }
+            for (int c = 0; c < TRACE_COUNTERS; c++)
+            {
+                counters[c] += thread->counters[c];
+            }
+        }
+        for (const auto& phase : phases)
+        {
+            fprintf(stderr, "%-28s %10.3f %10.3f %8lld\n", phase.first.c_str(), phase.second.wallNs / 1e6, phase.second.cpuNs / 1e6, phase.second.count);
+        }
+        fprintf(stderr, "---- trace: waits per thread (ms, waits) ----\n");
+        for (TraceThread* thread : threads)
+        {
+            std::map<std::string, Total> waits;
+            for (const TraceEvent& event : thread->events)
+            {
+                if (event.wait)
+                {
+                    Total& total = waits[event.name];
+                    total.count++;
+                    total.wallNs += event.wallNs;
+                }
+            }
+            for (const auto& wait : waits)
+            {
+                fprintf(stderr, "thread %-3d %-17s %10.3f %8lld\n", thread->id, wait.first.c_str(), wait.second.wallNs / 1e6, wait.second.count);
+            }
+        }
+        fprintf(stderr, "---- trace: counters ----\n");
+        const char* names[TRACE_COUNTERS] = {"codes decoded", "bits decoded", "nodes visited"};
+        for (int c = 0; c < TRACE_COUNTERS; c++)
+        {
+            fprintf(stderr, "%-28s %llu\n", names[c], (unsigned long long)counters[c]);
+        }
+    }
+
+    //every event as a complete ("X") event in microseconds, the counters as one counter ("C") event at the end
+    void writeChromeTrace(const char* path)
+    {
+        FILE* out = fopen(path, "w");
+        if (!out)
+        {
+            fprintf(stderr, "trace: could not open %s\n", path);
+            return;
+        }
+        fprintf(out, "{\"traceEvents\":[\n");
+        int64_t end = 0;
+        uint64_t counters[TRACE_COUNTERS] = {};
+        for (TraceThread* thread : threads)
+        {
+            for (const TraceEvent& event : thread->events)
+            {
+                fprintf(out, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpu_us\":%.3f}},\n",
+                        event.name, event.wait ? "wait" : "phase", thread->id, event.startNs / 1e3, event.wallNs / 1e3, event.cpuNs / 1e3);
+                end = event.startNs + event.wallNs > end ? event.startNs + event.wallNs : end;
+            }
+            for (int c = 0; c < TRACE_COUNTERS; c++)
+            {
+                counters[c] += thread->counters[c];
+            }
+        }
+        fprintf(out, "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"codes_decoded\":%llu,\"bits_decoded\":%llu,\"nodes_visited\":%llu}}\n]}\n",
+                end / 1e3, (unsigned long long)counters[TRACE_CODES_DECODED], (unsigned long long)counters[TRACE_BITS_DECODED], (unsigned long long)counters[TRACE_NODES_VISITED]);
+        fclose(out);
+    }
+};
+
+//records the interval from its construction to the end of its scope
+class TraceScope
+{
+public:
+    TraceScope(const char* name, bool wait = false) : thread(TraceRegistry::instance().thread())
+    {
+        event.name = name;
+        event.wait = wait;
+        event.startNs = TraceRegistry::instance().wallNs();
+        event.cpuNs = TraceRegistry::cpuNs();
+    }
+
+    ~TraceScope()
+    {
+        event.wallNs = TraceRegistry::instance().wallNs() - event.startNs;
+        event.cpuNs = TraceRegistry::cpuNs() - event.cpuNs;
+        thread.events.push_back(event);
+    }
+
+private:
+    TraceThread& thread;
+    TraceEvent event;
+};
+
+inline void traceCount(TraceCounter counter, uint64_t amount)
+{
+    TraceRegistry::instance().thread().counters[counter] += amount;
+}
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+//time the rest of the enclosing scope as the phase name
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(traceScope, __LINE__)(name)
+//time the rest of the enclosing scope as a wait
+#define TRACE_WAIT(name) TraceScope TRACE_JOIN(traceScope, __LINE__)(name, true)
+//add amount to a TraceCounter
+#define TRACE_COUNT(counter, amount) traceCount(counter, amount)
+//register the trace before any static object that uses it, so it is reported after them
+#define TRACE_INIT() TraceRegistry::instance()
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_WAIT(name)
+#define TRACE_COUNT(counter, amount)
+#define TRACE_INIT()
+
+#endif
+
+#endif
@@ -1,5 +1,8 @@
 // Optional file to implement an OOP solution for the Huffman Tree
 // Program is retrieved from assignment 1.
+#ifndef HUFFMANTREE_H
+#define HUFFMANTREE_H
+
 #include <iostream>
 #include <fstream>
 #include <utility>
@@ -8,22 +11,25 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include "huffmanSymbol.h"
 
 using namespace std;
 //define Huffman Tree
 //Huffman tree node is define by its character, frequency, left node, right node, left edge, and right edge
-struct HuffmanTreeNode
+//Symbol is the type of a character and Count the type of a frequency, see huffmanSymbol.h
+template <typename Symbol = char, typename Count = int>
+struct BasicHuffmanTreeNode
 {
-    char character;
-    int frequency;
+    Symbol character;
+    Count frequency;
     int counter; //initiate the counter to keep track with the order of the added node.
-    HuffmanTreeNode* left;
-    HuffmanTreeNode* right;
+    BasicHuffmanTreeNode* left;
+    BasicHuffmanTreeNode* right;
     string labelLeft;
     string labelRight;
     
     //initialize the Node 
-    HuffmanTreeNode (char ch, int freq, string labelLeft, string labelRigth, int nodeCounter)
+    BasicHuffmanTreeNode (Symbol ch, Count freq, string labelLeft, string labelRigth, int nodeCounter)
     {
         character=ch;
         frequency=freq;
@@ -34,13 +40,17 @@ struct HuffmanTreeNode
     }
 };
 
+//node of the assignments: one byte characters and int frequencies
+typedef BasicHuffmanTreeNode<> HuffmanTreeNode;
+
 //Implementation of Huffman Tree function class
 //Modify compare class for PQ
 class Compare{
 public: 
     /*Arrange the symbols based on their frequencies. If two or more symbols have the same frequency, they will be sorted based on their ASCII value.
     Insert internal node into the queue of nodes as the lowest node based on its frequency.*/
-    bool operator() (HuffmanTreeNode* first, HuffmanTreeNode* second)
+    template <typename Node>
+    bool operator() (Node* first, Node* second)
     {
         if (first->frequency==second->frequency) 
         {
@@ -48,20 +58,25 @@ public:
             {
                 return first->counter < second->counter; //using counter to determine the order.
             }
-            return (int)(first->character) > (int)(second->character); //compare ascii value if frequency is equal
+            return symbolRank(first->character) > symbolRank(second->character); //compare ascii value if frequency is equal
         }
         return first->frequency > second->frequency; //compare frequency 
     }
 };
 
+//priority_queue of the nodes of a tree
+template <typename Symbol = char, typename Count = int>
+using HuffmanQueue = priority_queue<BasicHuffmanTreeNode<Symbol, Count>*, vector<BasicHuffmanTreeNode<Symbol, Count>*>, Compare>;
+
 //initialize priority_queue
-priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> init_pq(char character[], int frequency[], int size, priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare>& pq,  int& nodeCounter)
+template <typename Symbol, typename Count>
+HuffmanQueue<Symbol, Count> init_pq(const Symbol character[], const Count frequency[], int size, HuffmanQueue<Symbol, Count>& pq,  int& nodeCounter)
 {
     //initialize priority_queue
     for (int i = 0; i < size; i++)
     {
         //initialize new HuffmanTree Node, increment counter each time it added in the code.
-        HuffmanTreeNode* newNode = new HuffmanTreeNode(character[i], frequency[i],"","",nodeCounter++);
+        BasicHuffmanTreeNode<Symbol, Count>* newNode = new BasicHuffmanTreeNode<Symbol, Count>(character[i], frequency[i],"","",nodeCounter++);
         //push into priority_queue
         pq.push(newNode);
     }
@@ -70,8 +85,10 @@ priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> init_pq(char
 
 //Function to build Huffman Tree using PQ
 //when push into new node, label left edge as 1, right edge as 0.
-HuffmanTreeNode* buildHuffmanTree(priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq, int& nodeCounter)
+template <typename Symbol, typename Count>
+BasicHuffmanTreeNode<Symbol, Count>* buildHuffmanTree(HuffmanQueue<Symbol, Count> pq, int& nodeCounter)
 {
+    typedef BasicHuffmanTreeNode<Symbol, Count> HuffmanTreeNode;
     //using while loop to generate the Tree
     while (pq.size()>1)
     {
@@ -87,7 +104,7 @@ HuffmanTreeNode* buildHuffmanTree(priority_queue<HuffmanTreeNode*, vector<Huffma
 
         //declare internal node which the value is the sum of its child frequency. Label left node as "0",right node as "1"
         //increment the counter when each node is create.
-        HuffmanTreeNode* i_node = new HuffmanTreeNode('\0', left->frequency+right->frequency,"0","1", nodeCounter++);
+        HuffmanTreeNode* i_node = new HuffmanTreeNode(Symbol(), left->frequency+right->frequency,"0","1", nodeCounter++);
         //build new branch of tree
         i_node->left = left;
         i_node->right = right;
@@ -101,7 +118,8 @@ HuffmanTreeNode* buildHuffmanTree(priority_queue<HuffmanTreeNode*, vector<Huffma
 //helper function to traverse tree to print binary code and store value in arr
 /* traverses a Huffman Tree to find the binary code of a target character. It starts at the root node and navigates down the
 tree, building the binary code as it goes. When it finds the target character, it prints the symbol, frequency, and code.*/
-void traverse(HuffmanTreeNode* root, char target, int arr[], int pos) {
+template <typename Symbol, typename Count>
+void traverse(BasicHuffmanTreeNode<Symbol, Count>* root, Symbol target, int arr[], int pos) {
     // If there's a left child, add a 0 to the binary code and continue traversing on the left branch
     if (root->left) {
         arr[pos] = 0;
@@ -117,7 +135,9 @@ void traverse(HuffmanTreeNode* root, char target, int arr[], int pos) {
     // If the current node is a leaf (no left or right children) and its character matches the target character
     if (!root->left && !root->right && root->character == target) {
         // Print the symbol, frequency, and binary code for the target character
-        cout << "Symbol: " << root->character << ", Frequency: " << root->frequency << ", Code: ";
+        string symbol;
+        appendSymbol(symbol, root->character);
+        cout << "Symbol: " << symbol << ", Frequency: " << root->frequency << ", Code: ";
         for (int i = 0; i < pos; i++) {
             cout << arr[i];
         }
@@ -126,9 +146,10 @@ void traverse(HuffmanTreeNode* root, char target, int arr[], int pos) {
 }
 
 //Helper function to traverse the Huffman tree and determine the character
-char getChar(HuffmanTreeNode* root, string binaryCode)
+template <typename Symbol, typename Count>
+Symbol getChar(BasicHuffmanTreeNode<Symbol, Count>* root, string binaryCode)
 {
-    HuffmanTreeNode* currentNode = root;
+    BasicHuffmanTreeNode<Symbol, Count>* currentNode = root;
     for (char c : binaryCode) {
         if (c=='0') {
             currentNode = currentNode->left; //travel left if the code is 0.
@@ -139,4 +160,84 @@ char getChar(HuffmanTreeNode* root, string binaryCode)
         }
     }
     return currentNode->character; //return character after traverse the binaryCode.
-}
\ No newline at end of file
+}
+
+//Function to free every node of a tree built by buildHuffmanTree, not only the root
+template <typename Symbol, typename Count>
+void deleteHuffmanTree(BasicHuffmanTreeNode<Symbol, Count>* root)
+{
+    vector<BasicHuffmanTreeNode<Symbol, Count>*> stack;
+    if (root)
+    {
+        stack.push_back(root);
+    }
+    while (!stack.empty())
+    {
+        BasicHuffmanTreeNode<Symbol, Count>* node = stack.back();
+        stack.pop_back();
+        if (node->left)
+        {
+            stack.push_back(node->left);
+        }
+        if (node->right)
+        {
+            stack.push_back(node->right);
+        }
+        delete node;
+    }
+}
+
+//helper function to print every leaf of the tree from left to right, storing the code of the current path in arr
+template <typename Symbol, typename Count>
+void traverseAll(BasicHuffmanTreeNode<Symbol, Count>* root, int arr[], int pos)
+{
+    //left traverse is 0, right traverse is 1
+    if (root->left)
+    {
+        arr[pos] = 0;
+        traverseAll(root->left, arr, pos + 1);
+    }
+    if (root->right)
+    {
+        arr[pos] = 1;
+        traverseAll(root->right, arr, pos + 1);
+    }
+
+    //print character and its code when we reach leaf node
+    if (!root->left && !root->right)
+    {
+        string symbol;
+        appendSymbol(symbol, root->character);
+        cout << "Symbol: " << symbol << ", Frequency: " << root->frequency << ", Code: ";
+        for (int i = 0; i < pos; i++)
+        {
+            cout << arr[i];
+        }
+        cout << endl;
+    }
+}
+
+//height of the subtree below node, a leaf has height 0
+template <typename Symbol, typename Count>
+int treeHeight(BasicHuffmanTreeNode<Symbol, Count>* node)
+{
+    if (!node->left && !node->right)
+    {
+        return 0;
+    }
+    int left = node->left ? treeHeight(node->left) : 0;
+    int right = node->right ? treeHeight(node->right) : 0;
+    return 1 + (left > right ? left : right);
+}
+
+//print result from generating HuffmanTree
+template <typename Symbol, typename Count>
+void encode(BasicHuffmanTreeNode<Symbol, Count>* root)
+{
+    //traverse huffman tree and print result. Initiate empty array to store result, one entry per level of the tree
+    vector<int> arr(treeHeight(root) + 1);
+    int position = 0;
+    traverseAll(root, arr.data(), position);
+}
+
+#endif
@@ -0,0 +1,291 @@
+// Input loading and parsing for the text formats.
+// The whole input is memory mapped when it is a regular file, or read in large blocks otherwise, and then scanned
+// in place: integers are parsed by hand without a stream, a locale or a temporary string per line.
+#ifndef INPUTLOADER_H
+#define INPUTLOADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Bytes of an input file or stream, mapped or copied into memory
+class InputBuffer
+{
+public:
+    InputBuffer() : mapped(nullptr), mappedSize(0), begin(nullptr), size(0) {}
+
+    ~InputBuffer()
+    {
+        release();
+    }
+
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+
+    //Load what is left of in. A regular file is mapped from the current position of in, which accounts for
+    //anything already peeked through in or cin, anything else is read to its end in large blocks.
+    bool load(FILE* in)
+    {
+        release();
+        struct stat info;
+        int fd = fileno(in);
+        long offset = ftell(in);
+        if (fd >= 0 && offset >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > offset)
+        {
+            if (map(fd, info.st_size))
+            {
+                begin = (const char*)mapped + offset;
+                size = info.st_size - offset;
+                fseek(in, 0, SEEK_END); //the input is consumed, as if it had been read
+                return true;
+            }
+        }
+        const size_t block = 1 << 20;
+        size_t used = 0;
+        while (true)
+        {
+            copy.resize(used + block);
+            size_t n = fread(&copy[used], 1, block, in);
+            used += n;
+            if (n < block)
+            {
+                break;
+            }
+        }
+        copy.resize(used);
+        begin = copy.data();
+        size = used;
+        return !ferror(in);
+    }
+
+    //Load what is left of in up to its first empty line. A regular file is mapped as load() does, and the scanner
+    //stops at the empty line. Anything else, a terminal or a pipe that stays open, is read line by line and left at
+    //the line after the empty one, so the caller does not wait for the end of the input.
+    bool loadUntilEmptyLine(FILE* in)
+    {
+        struct stat info;
+        int fd = fileno(in);
+        if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+        {
+            return load(in);
+        }
+        release();
+        int c;
+        bool lineStart = true;
+        while ((c = getc(in)) != EOF)
+        {
+            copy.push_back((char)c);
+            if (c == '\n' && lineStart)
+            {
+                break;
+            }
+            lineStart = c == '\n';
+        }
+        begin = copy.data();
+        size = copy.size();
+        return !ferror(in);
+    }
+
+    //Load the whole file at path, false if it cannot be opened
+    bool load(const char* path)
+    {
+        FILE* in = fopen(path, "rb");
+        if (!in)
+        {
+            return false;
+        }
+        bool loaded = load(in);
+        fclose(in);
+        return loaded;
+    }
+
+    const char* data() const
+    {
+        return begin;
+    }
+
+    size_t length() const
+    {
+        return size;
+    }
+
+private:
+    void* mapped;
+    size_t mappedSize;
+    std::vector<char> copy; //used when the input cannot be mapped
+    const char* begin;
+    size_t size;
+
+    bool map(int fd, size_t bytes)
+    {
+        void* address = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(address, bytes, MADV_SEQUENTIAL); //read once from front to back
+        mapped = address;
+        mappedSize = bytes;
+        return true;
+    }
+
+    void release()
+    {
+        if (mapped)
+        {
+            munmap(mapped, mappedSize);
+        }
+        mapped = nullptr;
+        mappedSize = 0;
+        copy.clear();
+        begin = nullptr;
+        size = 0;
+    }
+};
+
+//Scanner over a text in memory, line by line. Blanks are spaces, tabs and carriage returns; a newline is only
+//crossed by nextLine(), so the values of one line are read until endOfLine().
+class InputScanner
+{
+public:
+    InputScanner(const char* data, size_t size) : p(data), end(data + size) {}
+
+    bool atEnd() const
+    {
+        return p == end;
+    }
+
+    //true at the end of the input or at an empty line, without skipping anything
+    bool atEmptyLine() const
+    {
+        return p == end || *p == '\n';
+    }
+
+    //skip the blanks, true if the line has no more values
+    bool endOfLine()
+    {
+        skipBlanks();
+        return p == end || *p == '\n';
+    }
+
+    //move to the start of the next line
+    void nextLine()
+    {
+        while (p != end && *p != '\n')
+        {
+            p++;
+        }
+        if (p != end)
+        {
+            p++;
+        }
+    }
+
+    //read the next character as it is, blanks included, '\0' at the end of the input
+    char readChar()
+    {
+        return p != end ? *p++ : '\0';
+    }
+
+    //Read the next integer of the line, false if the line has no more values or the next value is not a number.
+    //Up to 8 digits are found and converted at once from one 64 bit load, longer numbers continue digit by digit.
+    template <typename Integer>
+    bool readInt(Integer& value)
+    {
+        skipBlanks();
+        bool negative = p != end && *p == '-';
+        const char* digits = negative ? p + 1 : p;
+        uint64_t result = 0;
+        const char* q = digits;
+        if (end - q >= 8)
+        {
+            uint64_t chunk;
+            memcpy(&chunk, q, 8);
+            int count = leadingDigits(chunk);
+            if (count > 0)
+            {
+                result = convertDigits(chunk, count);
+                q += count;
+            }
+        }
+        while (q != end && (unsigned)(*q - '0') < 10)
+        {
+            result = result * 10 + (*q - '0');
+            q++;
+        }
+        if (q == digits)
+        {
+            return false;
+        }
+        p = q;
+        value = negative ? -(Integer)result : (Integer)result;
+        return true;
+    }
+
+    //Read the next word of the line into token, false if the line has no more values
+    bool readToken(std::string& token)
+    {
+        if (endOfLine())
+        {
+            return false;
+        }
+        const char* start = p;
+        while (p != end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+        {
+            p++;
+        }
+        token.assign(start, p - start);
+        return true;
+    }
+
+    //Read the integers up to the end of the line and append them to values, a vector or a PositionTable row
+    template <typename Container>
+    void readInts(Container& values)
+    {
+        long long value;
+        while (readInt(value))
+        {
+            values.push_back(value);
+        }
+    }
+
+private:
+    const char* p;
+    const char* end;
+
+    //number of digit characters at the start of the 8 characters of chunk (first character in the low byte)
+    static int leadingDigits(uint64_t chunk)
+    {
+        //a byte is a digit when its high nibble is 3 and its low nibble does not pass 9 once 6 is added
+        uint64_t high = (chunk & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull;
+        uint64_t low = ((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) ^ 0x3030303030303030ull;
+        uint64_t other = high | low;
+        return other ? __builtin_ctzll(other) >> 3 : 8;
+    }
+
+    //value of the first count (1..8) digit characters of chunk, combining pairs of digits, then pairs of pairs
+    static uint32_t convertDigits(uint64_t chunk, int count)
+    {
+        uint64_t x = (chunk - 0x3030303030303030ull) << (8 * (8 - count)); //leading zeros fill the low bytes
+        x = ((x & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+        x = ((x & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+        x = ((x & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+        return (uint32_t)x;
+    }
+
+    void skipBlanks()
+    {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+    }
+};
+
+#endif
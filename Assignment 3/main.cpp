@@ -6,184 +6,228 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <cstring>
 #include <pthread.h>
 #include "huffmanTree.h"
-
-/*struct arguments to hold information among each threads*/
+#include "huffmanTable.h"
+#include "huffmanFlatTree.h"
+#include "huffmanStream.h"
+#include "huffmanBlocks.h"
+#include "huffmanCache.h"
+#include "threadPool.h"
+#include "orderedPublisher.h"
+#include "positionTable.h"
+#include "scatter.h"
+#include "inputLoader.h"
+#include "huffmanTrace.h"
+
+/*struct arguments to hold the information shared by every chunk of the thread pool*/
 struct arguments {
-    HuffmanTreeNode* root; //Pointer to root of the Huffman Tree.
+    const FlatHuffmanTree64* tree; //Pointer to the Huffman Tree stored as a flat node array.
+    DecodeMode mode; //Engine used to turn a binary code into its symbol.
+    const HuffmanDecodeTable* table; //Pointer to the decode tables derived from the Huffman Tree.
+    const FlatCodeTable* codes; //Pointer to the code, length, and frequency of every leaf of the Huffman Tree.
     std::vector<std::string>* binaryCodes; //Pointer to vector of binary code of each character.
-    int index; //Index of current character being processed by Thread.
-    int n; //number of line or unique characters. 
-    int* current_index; //Pointer to an integer that represents the current index of the character.
-    int* thread_counter; //Pointer to an integer that representing the number of threads that have completed.
-    std::vector<char>* decompressed_message; //Pointer to the vector representing the decompressed message.
-    std::vector<std::vector<int>>* positions; //Pointer to the vector of positions representing the positions of each character in the decompressed message.
-    pthread_mutex_t* mutex; //Pointer to the mutex used for synchronization in each critical section.
-    pthread_cond_t* cond; //Pointer to condition variable used for synchronization in each critical section.
-    pthread_mutex_t* printMutex; //Pointer to mutex used for synchronization for printing symbol, frequency, and code.
-    pthread_cond_t* printCond; //Pointer to conditional variable used for synchronization for printing symbol, frequency, and code.
+    std::vector<int>* chunkStart; //Pointer to the first character of every chunk, followed by n.
+    OrderedPublisher* report; //Pointer to the symbol, frequency, and code line of every character, printed in order.
+    pthread_t consumer; //The only thread that prints the report lines.
+    std::vector<char>* symbols; //Pointer to the vector receiving the decoded character of each binary code.
 };
 
-/*main Thread function for printing in order and store original message by using synchronization.*/
-void* mainThread(void* arg) {
-    arguments* main_args = (arguments*)arg; //Cast the input argument to a arguments pointer.
+/*Decompress the characters of one chunk. A chunk owns a contiguous range of characters and publishes the report
+line of each of them without waiting for the characters before it. The consumer thread prints the lines that are
+ready in order whenever it finishes a character, the other threads never print.*/
+void decompressChunk(const arguments& args, int chunk) {
+    TRACE_SCOPE("decode chunk");
+    bool consumer = pthread_equal(pthread_self(), args.consumer);
+    for (int index = (*args.chunkStart)[chunk]; index < (*args.chunkStart)[chunk + 1]; ++index) {
+        /*Use Huffman Tree method to find the binary code and symbol*/
+        char symbol = decodeChar(args.mode, *args.tree, args.table, (*args.binaryCodes)[index]);
+
+        // Publish the symbol, frequency, and code, looked up in the code table
+        std::string line;
+        int32_t leaf = args.codes->leafOf[symbol];
+        if (leaf >= 0) {
+            appendCodeLine(line, *args.tree, *args.codes, leaf);
+        }
+        args.report->publish(index, std::move(line));
+        (*args.symbols)[index] = symbol;
 
-    // Create local args object
-    arguments args;
-    {
-        /*CRITICAL SECTION 1
-        Copy main_args values into local args and signal the main thread to continue. 
-        Guarantee that each thread has its own copy of the arguments, which prevents any race conditions*/
-        pthread_mutex_lock(main_args->mutex); //Lock the mutex therefore no other thread can access main_args.
-        args = *main_args; //Copy main_args into local args object
-        pthread_cond_signal(main_args->cond); //Signal the main thread to continue creating new threads.
-        pthread_mutex_unlock(main_args->mutex); //Unlock the mutex, allowing other threads to access main_args.
+        if (consumer) {
+            args.report->emit(std::cout);
+        }
     }
-    
-    /*Use Huffman Tree method to find the binary code and symbol*/
-    std::string binaryCode = (*(args.binaryCodes))[args.index];
-    char symbol = getChar(args.root, binaryCode);
+}
 
-    /*CRITICAL SECTION 2
-    Waiting for the thread's turn to print translation info that only one thread can access the shared current_index variable at a time.
-    Guarantee that printing is done in the correct order based on the order we read the compressed file.*/
-    pthread_mutex_lock(args.printMutex); //Lock the printMutex therefore no other thread can access current_index.
-    while (args.index != *args.current_index) //Wait for it is this thread turn to print.
-    { 
-        pthread_cond_wait(args.printCond, args.printMutex); //Wait for a signal from another thread.
+/*Decompress a packed container from STDIN. The alphabet comes from the container header and the message is
+decoded from the packed payload, so there is no position list to parse and no need to hold the whole message.
+A single payload is decoded sequentially, the blocks of a blocked container on every core.*/
+int decompressPacked(DecodeMode mode) {
+    InputBuffer input;
+    if (!input.load(stdin)) {
+        std::cerr << "Error: could not read the input" << std::endl;
+        return 1;
+    }
+    MemoryStreamBuffer bytes(input.data(), input.length());
+    std::istream in(&bytes);
+    BitReader reader(in);
+    StreamHeader header;
+    if (!readStreamHeader(reader, header)) {
+        std::cerr << "Error: invalid compressed file" << std::endl;
+        return 1;
     }
 
-    // Print the symbol, frequency, and code
-    int arr[100]; //Helper array to print.
-    traverse(args.root, symbol, arr, 0); //Print the symbol, frequency, and code
-
-    // Write the decoded character to the output array
-    for (int pos : (*(args.positions))[args.index]) {
-        (*(args.decompressed_message))[pos] = symbol;
+    // Build the Huffman Tree, or the canonical code, described by the header
+    StreamCodec codec;
+    if (!prepareStreamCodec(header, codec)) {
+        std::cerr << "Error: unsupported code lengths" << std::endl;
+        return 1;
     }
 
-    /*CRITICAL SECTION 3:
-    Incremnting the shared current_index value to signal that it's the next thread's turn to print.*/
-    (*args.current_index)++; //Increment the shared current_index.
-    pthread_cond_signal(args.printCond); //Signal the next waiting thread to print.
-    pthread_mutex_unlock(args.printMutex); //Unlock the printMutex and allow other threads to access current_index.
+    // Print the symbol, frequency, and code in alphabet order
+    printStreamCodes(header, codec);
 
-    // Increment the thread_counter and signal the main thread if all threads are done
-    pthread_mutex_lock(args.mutex); //Lock the mutex to therefore no other thread can access thread_counter.
-    (*args.thread_counter)++;//Increment the thread_counter.
-    
-    if (*args.thread_counter == args.n) //Check if all threads are completed.
-    {
-        pthread_cond_signal(args.cond); //Signal the main thread that all thread are done.
+    // Decode the payload and print the original message window by window, the memory used does not grow with it
+    TRACE_SCOPE("decode stream");
+    ThreadPool pool;
+    cout << "Original message: ";
+    if (!decodeContainerTo(pool, reader, header, codec, mode, input.data(), input.length(), cout)) {
+        cout << endl;
+        std::cerr << "Error: truncated compressed file" << std::endl;
+        return 1;
     }
-    pthread_mutex_unlock(args.mutex); //Unlock the mutex and allow other threads to access thread_counter.
+    cout << endl;
+    return 0;
+}
 
-    return nullptr;
+/*Read the cache file of built trees from the command line: --cache=FILE, none by default*/
+const char* parseCachePath(int argc, char* argv[]) {
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--cache=", 8) == 0) {
+            path = argv[i] + 8;
+        }
+    }
+    return path;
 }
 
 // Driver code
-int main() {
-    /* Reading input */
-    int n;
-    std::cin >> n;
-    std::cin.ignore();
+int main(int argc, char* argv[]) {
+    TRACE_INIT(); // reported at exit, with HUFFMAN_TRACE defined
+    DecodeMode mode = parseDecodeMode(argc, argv); //Select the tree walk or the table decoder.
+    if (isPackedStream(std::cin)) {
+        return decompressPacked(mode); //Packed container instead of the text format.
+    }
+
+    /* Reading input: the whole input is mapped or read in large blocks and scanned in place */
+    InputBuffer input;
+    {
+        TRACE_SCOPE("load input");
+        if (!input.load(stdin)) {
+            std::cerr << "Error: could not read the input" << std::endl;
+            return 1;
+        }
+    }
+    InputScanner scanner(input.data(), input.length());
+    int n = 0;
+    scanner.readInt(n);
+    scanner.nextLine();
 
     // Initialize empty list of characters and frequencies
     std::vector<char> characters(n);
-    std::vector<int> frequencies(n);
-    int total_characters = 0; // Add a variable to store the total number of characters in the original message
+    std::vector<uint64_t> frequencies(n); // 64 bit, the message can hold more than 2^31 characters
+    uint64_t total_characters = 0; // Add a variable to store the total number of characters in the original message
 
     // Read input for characters and frequencies
-    string line;
-    for (int i = 0; i < n; ++i) {
-        getline(cin, line);
-        istringstream iss(line);
-        characters[i] = iss.get(); // Use get() to read the first character including whitespace
-        iss >> frequencies[i];
-        total_characters += frequencies[i]; // Update the total number of characters
+    {
+        TRACE_SCOPE("parse alphabet");
+        for (int i = 0; i < n; ++i) {
+            characters[i] = scanner.readChar(); // the first character of the line is the symbol, even a space
+            frequencies[i] = 0;
+            scanner.readInt(frequencies[i]);
+            scanner.nextLine();
+            total_characters += frequencies[i]; // Update the total number of characters
+        }
     }
 
-    // Initialize priority_queue
-    priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq;
-    int nodeCounter = 0; // Add a nodeCounter variable to keep track of node order
-    init_pq(characters.data(), frequencies.data(), n, pq, nodeCounter);
-
-    // Build HuffmanTree
-    HuffmanTreeNode* root = buildHuffmanTree(pq, nodeCounter);
+    // Build HuffmanTree in one contiguous node array, its decode tables and the code of every character, they are
+    // shared read-only by every thread. They only depend on the alphabet: one found in the cache file is not built.
+    HuffmanCache<char, uint64_t> cache;
+    const char* cachePath = parseCachePath(argc, argv);
+    if (cachePath && !cache.open(cachePath)) {
+        std::cerr << "Warning: could not use the cache file " << cachePath << std::endl;
+    }
+    const CachedAlphabet<char, uint64_t>* alphabet;
+    {
+        TRACE_SCOPE("build tree");
+        alphabet = &cache.lookup(characters.data(), frequencies.data(), n);
+    }
+    const FlatHuffmanTree64& tree = alphabet->tree;
+    const HuffmanDecodeTable& table = alphabet->table;
+    const FlatCodeTable& codes = alphabet->codes;
 
-    // Read input for binary codes and positions
+    // Read input for binary codes and positions, the positions of every character go one after the other in one array
     std::vector<string> binaryCodes(n);
-    std::vector<vector<int> > positions(n);
-
-    for (int i = 0; i < n; ++i) {
-        getline(cin, line);
-        istringstream iss(line);
-        iss >> binaryCodes[i];
+    PositionTable positions;
+    positions.reserve(n, total_characters);
 
-        int p;
-        while (iss >> p) {
-            positions[i].push_back(p);
+    {
+        TRACE_SCOPE("parse positions");
+        for (int i = 0; i < n; ++i) {
+            scanner.readToken(binaryCodes[i]);
+            scanner.readInts(positions);
+            positions.endRow();
+            scanner.nextLine();
         }
     }
+    if (positions.tooLarge() > 0) {
+        std::cerr << "Error: positions beyond 4 GiB need a build with HUFFMAN_POSITIONS_64" << std::endl;
+        return 1;
+    }
 
     // Initialize shared decompressed_message vector
     std::vector<char> decompressed_message(total_characters, '\0');
     
-    // Initialize mutex and condition variable
-    pthread_mutex_t mutex;
-    pthread_mutex_init(&mutex, nullptr);
-    pthread_cond_t cond;
-    pthread_cond_init(&cond, nullptr);
-    
-    // Initialize printMutex and printCond
-    pthread_mutex_t printMutex;
-    pthread_mutex_init(&printMutex, nullptr);
-    pthread_cond_t printCond;
-    pthread_cond_init(&printCond, nullptr);
-    
-    int current_index = 0; //variable to keep track of the order of synchronization among threads when they are printing.
-    int thread_counter = 0; //variable to keep track of the number of threads that have completed their tasks.
-    
-    /*Initialize the arguments object*/
-    arguments main_args = {root, &binaryCodes, 0, n, &current_index, &thread_counter, &decompressed_message, &positions, &mutex, &cond, &printMutex, &printCond};
-    pthread_t threads[n]; //Create an array of pthread_t threads with the size n.
-    for (int i = 0; i < n; ++i) //Loop through each thread.
-    { 
-        main_args.index = i; //Set the index of the current thread in the main_args.
-
-        /*Critical section to ensure synchronization between the parent thread and the child threads during their creation.*/
-        pthread_mutex_lock(&mutex); //Lock the mutex to protect shared resources during thread creation
-        if (pthread_create(&threads[i], nullptr, mainThread, &main_args)) //Create a new thread and start the mainThread function with the main_args as an argument.
-        {
-            fprintf(stderr, "Error creating thread\n");
-			return 1;
-        }
-        pthread_cond_wait(&cond, &mutex); //Wait for the signal from the newly created thread, indicating that it has copied the main_args data.
-        pthread_mutex_unlock(&mutex); //Unlock the mutex after the thread has copied the main_args data.
+    /*Split the characters into contiguous chunks of the same size, a few chunks per thread*/
+    ThreadPool pool;
+    int chunks = std::min(n, pool.size() * 4);
+    std::vector<int> chunkStart(chunks + 1);
+    for (int i = 0; i <= chunks; ++i) {
+        chunkStart[i] = (long long)n * i / chunks;
     }
 
-    /*Wait for all threads to finish using pthread_join.
-    Guarantee that the parent thread waits for all its child threads to end before ending its execution*/
-    for (int i = 0; i < n; ++i) {
-        pthread_join(threads[i], nullptr);
+    /*Initialize the arguments object and decode every chunk on the pool*/
+    OrderedPublisher report;
+    report.reset(n);
+    std::vector<char> symbols(n);
+    arguments args = {&tree, mode, &table, &codes, &binaryCodes, &chunkStart, &report, pthread_self(), &symbols};
+    {
+        TRACE_SCOPE("decode");
+        pool.run(chunks, [&](int chunk) { decompressChunk(args, chunk); });
     }
 
-    //Clean up mutex and condition variable
-    pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&cond);
-    pthread_mutex_destroy(&printMutex);
-    pthread_cond_destroy(&printCond);
-    
-    //Delete Huffman Tree
-    delete(root);
+    // Print the symbol, frequency, and code lines that were published after the last one the main thread printed
+    {
+        TRACE_SCOPE("print report");
+        report.emit(std::cout);
+    }
+
+    // Write the decoded characters to their positions, every cache line of the message is written by one thread
+    {
+        TRACE_SCOPE("scatter");
+        scatterPositions(pool, symbols, positions, decompressed_message.data(), decompressed_message.size());
+    }
 
     // Print the original message
-    cout << "Original message: ";
-    for (char ch : decompressed_message) {
-        std::cout << ch;
+    {
+        TRACE_SCOPE("print message");
+        cout << "Original message: ";
+        for (char ch : decompressed_message) {
+            std::cout << ch;
+        }
+        std::cout << endl;
     }
-    std::cout << endl;
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+// Ordered publication of results computed out of order.
+// Every result has a slot and a ready flag. A worker fills its slot and publishes it with one release store, it
+// never waits for the results before it. A single consumer emits the slots in order as far as they are ready.
+#ifndef ORDEREDPUBLISHER_H
+#define ORDEREDPUBLISHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class OrderedPublisher
+{
+public:
+    OrderedPublisher() : count(0), round(0), next(0), capacity(0) {}
+
+    //Prepare count empty slots. The flags hold the round in which their slot was published, so starting a new
+    //round does not need to clear them unless the slots have to grow.
+    void reset(size_t slots)
+    {
+        if (slots > capacity)
+        {
+            ready.reset(new std::atomic<uint32_t>[slots]);
+            for (size_t i = 0; i < slots; i++)
+            {
+                ready[i].store(0, std::memory_order_relaxed);
+            }
+            capacity = slots;
+            round = 0;
+        }
+        lines.resize(slots);
+        count = slots;
+        next = 0;
+        round++;
+    }
+
+    //Worker side: store the result of slot and make it visible to the consumer
+    void publish(size_t slot, std::string&& line)
+    {
+        lines[slot] = std::move(line);
+        ready[slot].store(round, std::memory_order_release);
+    }
+
+    //Consumer side: write every slot that is ready in order and stop at the first one that is not.
+    //Returns the number of slots written.
+    size_t emit(std::ostream& out)
+    {
+        size_t start = next;
+        while (next < count && ready[next].load(std::memory_order_acquire) == round)
+        {
+            out << lines[next];
+            std::string().swap(lines[next]); //release the memory of the line once written
+            next++;
+        }
+        return next - start;
+    }
+
+    //true once every slot was written by emit
+    bool done() const
+    {
+        return next == count;
+    }
+
+private:
+    std::vector<std::string> lines;
+    std::unique_ptr<std::atomic<uint32_t>[]> ready;
+    size_t count;    //slots of this round
+    uint32_t round;  //value of a published flag in this round
+    size_t next;     //first slot not written yet, only used by the consumer
+    size_t capacity; //number of flags allocated
+};
+
+#endif
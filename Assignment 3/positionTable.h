@@ -0,0 +1,126 @@
+// Position lists of every symbol in compressed sparse row form.
+// The positions of all the symbols are stored one list after the other in one contiguous array, and offsets[i] is
+// where the list of symbol i starts, offsets[n] being the total. Reading the input, handing the lists to the threads
+// and scattering the symbols only walk spans of that array: nothing is allocated or copied per symbol.
+#ifndef POSITIONTABLE_H
+#define POSITIONTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+//Positions are 32 bit, which holds messages up to 4 GiB; build with HUFFMAN_POSITIONS_64 for larger ones
+#ifdef HUFFMAN_POSITIONS_64
+typedef uint64_t Position;
+#else
+typedef uint32_t Position;
+#endif
+
+//View of the positions of one symbol inside a PositionTable
+struct PositionSpan
+{
+    const Position* first;
+    const Position* last;
+
+    const Position* begin() const
+    {
+        return first;
+    }
+
+    const Position* end() const
+    {
+        return last;
+    }
+
+    size_t size() const
+    {
+        return last - first;
+    }
+
+    bool empty() const
+    {
+        return first == last;
+    }
+};
+
+class PositionTable
+{
+public:
+    PositionTable() : offsets(1, 0), dropped(0) {}
+
+    //Reserve room for the given number of symbols and positions, when they are known before reading
+    void reserve(size_t symbols, size_t total)
+    {
+        offsets.reserve(symbols + 1);
+        values.reserve(total);
+    }
+
+    //Append a position to the list of the current symbol, the one after the last endRow().
+    //A negative position is outside any message and is dropped. A position that does not fit in Position is
+    //dropped and counted in tooLarge(), instead of wrapping around to a wrong place of the message.
+    void push_back(long long position)
+    {
+        if (position < 0)
+        {
+            return;
+        }
+        if ((unsigned long long)position > std::numeric_limits<Position>::max())
+        {
+            dropped++;
+            return;
+        }
+        values.push_back((Position)position);
+    }
+
+    //number of positions dropped because they do not fit in Position, build with HUFFMAN_POSITIONS_64 for them
+    size_t tooLarge() const
+    {
+        return dropped;
+    }
+
+    //Close the list of the current symbol, the next positions belong to the next symbol
+    void endRow()
+    {
+        offsets.push_back(values.size());
+    }
+
+    //number of symbols
+    size_t rows() const
+    {
+        return offsets.size() - 1;
+    }
+
+    //number of positions of every symbol together
+    size_t total() const
+    {
+        return values.size();
+    }
+
+    PositionSpan operator[](size_t row) const
+    {
+        const Position* base = values.data();
+        return {base + offsets[row], base + offsets[row + 1]};
+    }
+
+    //size of a message holding every position, largest position + 1
+    size_t messageSize() const
+    {
+        size_t size = 0;
+        for (Position position : values)
+        {
+            if ((size_t)position + 1 > size)
+            {
+                size = (size_t)position + 1;
+            }
+        }
+        return size;
+    }
+
+private:
+    std::vector<size_t> offsets;
+    std::vector<Position> values;
+    size_t dropped; //positions beyond the range of Position
+};
+
+#endif
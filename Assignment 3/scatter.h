@@ -0,0 +1,136 @@
+// Scatter of decoded symbols to their positions in the message.
+// Every symbol owns a list of positions spread over the whole message, so threads filling the message symbol by
+// symbol all write to the same cache lines. Here the positions are first bucketed by output stripe, a run of whole
+// cache lines, and every stripe is then filled by one thread: no cache line is written by two cores.
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <cstdint>
+#include <vector>
+#include "threadPool.h"
+#include "positionTable.h"
+#include "simdKernels.h"
+
+//size of the unit that must not be shared between threads
+const size_t CACHE_LINE = 64;
+
+//below this message size the bucketing costs more than it saves
+const size_t SCATTER_MIN_PARALLEL = 1 << 16;
+
+//position of one symbol in the message, bucketed by stripe
+struct ScatterEntry
+{
+    Position position;
+    char symbol;
+};
+
+//Split the first n symbols into at most chunks contiguous ranges holding about the same number of positions.
+//Returns the first symbol of every range followed by the number of symbols.
+std::vector<int> splitByPositions(const PositionTable& positions, int n, int chunks)
+{
+    long long total = n; //every symbol also counts for the work done once per symbol
+    for (int i = 0; i < n; i++)
+    {
+        total += positions[i].size();
+    }
+    std::vector<int> start(1, 0);
+    long long assigned = 0;
+    for (int i = 0; i < n; i++)
+    {
+        assigned += positions[i].size() + 1;
+        if ((int)start.size() < chunks && assigned * chunks >= (long long)start.size() * total)
+        {
+            start.push_back(i + 1);
+        }
+    }
+    if (start.back() != n)
+    {
+        start.push_back(n);
+    }
+    return start;
+}
+
+//Function to write symbols[i] at every position of positions[i] in out, which holds size characters.
+//Positions outside the message are ignored, and so are the rows of positions without a symbol.
+void scatterPositions(ThreadPool& pool, const std::vector<char>& symbols, const PositionTable& positions, char* out, size_t size)
+{
+    size_t rows = positions.rows() < symbols.size() ? positions.rows() : symbols.size();
+    int threads = pool.size();
+    if (threads == 1 || size < SCATTER_MIN_PARALLEL)
+    {
+        SimdLevel level = simdLevel();
+        for (size_t i = 0; i < rows; i++)
+        {
+            fillPositionsWith(level, positions[i].begin(), positions[i].end(), symbols[i], out, size);
+        }
+        return;
+    }
+
+    //Stripes are whole cache lines of the output: position p falls in stripe (p + misalign) / stripeBytes.
+    //A few stripes per thread balance the fill without making the per chunk counts large.
+    size_t misalign = (uintptr_t)out % CACHE_LINE;
+    size_t stripeBytes = (size + misalign + threads * 16 - 1) / (threads * 16);
+    stripeBytes = (stripeBytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    size_t stripes = (size + misalign + stripeBytes - 1) / stripeBytes;
+
+    std::vector<int> chunkStart = splitByPositions(positions, rows, threads * 4);
+    int chunks = chunkStart.size() - 1;
+
+    //count the positions of every chunk in every stripe
+    std::vector<size_t> offset(chunks * stripes, 0);
+    pool.run(chunks, [&](int chunk) {
+        size_t* count = &offset[chunk * stripes];
+        for (int i = chunkStart[chunk]; i < chunkStart[chunk + 1]; i++)
+        {
+            for (Position pos : positions[i])
+            {
+                if (pos < size)
+                {
+                    count[(pos + misalign) / stripeBytes]++;
+                }
+            }
+        }
+    });
+
+    //turn the counts into where every chunk writes in every stripe, stripes are contiguous in entries
+    std::vector<size_t> stripeStart(stripes + 1);
+    size_t total = 0;
+    for (size_t s = 0; s < stripes; s++)
+    {
+        stripeStart[s] = total;
+        for (int chunk = 0; chunk < chunks; chunk++)
+        {
+            size_t count = offset[chunk * stripes + s];
+            offset[chunk * stripes + s] = total;
+            total += count;
+        }
+    }
+    stripeStart[stripes] = total;
+
+    //bucket the positions by stripe
+    std::vector<ScatterEntry> entries(total);
+    pool.run(chunks, [&](int chunk) {
+        size_t* next = &offset[chunk * stripes];
+        for (int i = chunkStart[chunk]; i < chunkStart[chunk + 1]; i++)
+        {
+            char symbol = symbols[i];
+            for (Position pos : positions[i])
+            {
+                if (pos < size)
+                {
+                    entries[next[(pos + misalign) / stripeBytes]++] = {pos, symbol};
+                }
+            }
+        }
+    });
+
+    //fill every stripe from one thread
+    pool.run(stripes, [&](int stripe) {
+        for (size_t e = stripeStart[stripe]; e < stripeStart[stripe + 1]; e++)
+        {
+            out[entries[e].position] = entries[e].symbol;
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,259 @@
+// Vector kernels of the two data-parallel loops: the byte histogram of the encoder and the fill of a symbol at its
+// list of positions. Both loops have a portable version and vector versions compiled with target attributes, so the
+// programs need no -mavx flags; the best one the processor supports is picked once by CPUID.
+//   histogram  AVX-512 gives every lane of the vector its own table, so the 16 counters one gather/scatter updates
+//              are never the same and no conflict detection is needed. AVX2 has no scatter, and eight scalar tables
+//              fed from 32 byte loads were no faster than the four of the portable loop, so AVX2 keeps that one.
+//   fill       x86 has no byte scatter, and a dword scatter would overwrite the neighbours of every position, so
+//              the stores stay scalar. The kernels check 8 or 16 positions against the message size with one vector
+//              compare and then store them without a branch each; the stores and their cache misses remain the cost.
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "positionTable.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HUFFMAN_SIMD_X86
+#include <immintrin.h>
+#endif
+
+//instruction sets of the kernels, in increasing order
+enum SimdLevel
+{
+    SIMD_PORTABLE,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+const char* simdLevelName(SimdLevel level)
+{
+    return level == SIMD_AVX512 ? "avx512" : level == SIMD_AVX2 ? "avx2" : "portable";
+}
+
+//Function to find the best instruction set of this processor
+SimdLevel detectSimdLevel()
+{
+#ifdef HUFFMAN_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_AVX2;
+    }
+#endif
+    return SIMD_PORTABLE;
+}
+
+//instruction set used by the kernels, detected on the first call
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+//the counters of the kernels are 32 bit, they are added to the 64 bit counts every 1 GiB before they can overflow
+const size_t HISTOGRAM_FLUSH = (size_t)1 << 30;
+
+//Function to count the frequency of every byte value with scalar code.
+//Four interleaved tables keep consecutive equal bytes from serializing on the same counter, the input is
+//consumed eight bytes per load.
+void countFrequenciesPortable(const unsigned char* data, size_t size, uint64_t counts[256])
+{
+    uint32_t tables[4][256];
+    memset(tables, 0, sizeof(tables));
+    memset(counts, 0, 256 * sizeof(uint64_t));
+
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t end = size - i > HISTOGRAM_FLUSH ? i + HISTOGRAM_FLUSH : size;
+        for (; i + 16 <= end; i += 16)
+        {
+            uint64_t a, b;
+            memcpy(&a, data + i, 8);
+            memcpy(&b, data + i + 8, 8);
+            for (int shift = 0; shift < 64; shift += 16)
+            {
+                tables[0][(a >> shift) & 0xff]++;
+                tables[1][(a >> (shift + 8)) & 0xff]++;
+                tables[2][(b >> shift) & 0xff]++;
+                tables[3][(b >> (shift + 8)) & 0xff]++;
+            }
+        }
+        for (; i < end; i++)
+        {
+            tables[0][data[i]]++;
+        }
+        for (int s = 0; s < 256; s++)
+        {
+            counts[s] += (uint64_t)tables[0][s] + tables[1][s] + tables[2][s] + tables[3][s];
+        }
+        memset(tables, 0, sizeof(tables));
+    }
+}
+
+#ifdef HUFFMAN_SIMD_X86
+//Sixteen tables interleaved by lane, the counter of byte b in lane l is b * 16 + l, so the 16 bytes of one load always
+//gather and scatter 16 different counters. A gather sees every earlier scatter of the thread, but both loads of an
+//iteration are gathered before either is scattered: if they shared a counter, the second scatter would write back
+//the value read before the first increment and lose it. The two loads therefore use two separate sets of tables.
+__attribute__((target("avx512f")))
+void countFrequenciesAvx512(const unsigned char* data, size_t size, uint64_t counts[256])
+{
+    const int SET = 256 * 16;
+    alignas(64) uint32_t tables[2 * SET];
+    memset(tables, 0, sizeof(tables));
+    memset(counts, 0, 256 * sizeof(uint64_t));
+    //the masked forms, as the unmasked ones pass an undefined vector that GCC warns about
+    const __mmask16 all = 0xffff;
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i secondLane = _mm512_add_epi32(lane, _mm512_set1_epi32(SET));
+    const __m512i one = _mm512_set1_epi32(1);
+
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t end = size - i > HISTOGRAM_FLUSH ? i + HISTOGRAM_FLUSH : size;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m512i first = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128((const __m128i*)(data + i)));
+            __m512i second = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128((const __m128i*)(data + i + 16)));
+            first = _mm512_add_epi32(_mm512_maskz_slli_epi32(all, first, 4), lane);
+            second = _mm512_add_epi32(_mm512_maskz_slli_epi32(all, second, 4), secondLane);
+            __m512i firstCounters = _mm512_mask_i32gather_epi32(one, all, first, tables, 4);
+            __m512i secondCounters = _mm512_mask_i32gather_epi32(one, all, second, tables, 4);
+            _mm512_i32scatter_epi32(tables, first, _mm512_add_epi32(firstCounters, one), 4);
+            _mm512_i32scatter_epi32(tables, second, _mm512_add_epi32(secondCounters, one), 4);
+        }
+        for (; i < end; i++)
+        {
+            tables[data[i] * 16]++;
+        }
+        for (int s = 0; s < 256; s++)
+        {
+            uint64_t count = 0;
+            for (int l = 0; l < 16; l++)
+            {
+                count += (uint64_t)tables[s * 16 + l] + tables[SET + s * 16 + l];
+            }
+            counts[s] += count;
+        }
+        memset(tables, 0, sizeof(tables));
+    }
+}
+#endif
+
+//Function to count the frequency of every byte value with the kernel of the given instruction set
+void countFrequenciesWith(SimdLevel level, const unsigned char* data, size_t size, uint64_t counts[256])
+{
+#ifdef HUFFMAN_SIMD_X86
+    if (level == SIMD_AVX512)
+    {
+        countFrequenciesAvx512(data, size, counts);
+        return;
+    }
+#endif
+    countFrequenciesPortable(data, size, counts);
+}
+
+//Function to write symbol at every position of [first, last) in out, which holds size characters.
+//Positions outside the message are ignored.
+void fillPositionsPortable(const Position* first, const Position* last, char symbol, char* out, size_t size)
+{
+    for (const Position* pos = first; pos != last; pos++)
+    {
+        if (*pos < size)
+        {
+            out[*pos] = symbol;
+        }
+    }
+}
+
+#if defined(HUFFMAN_SIMD_X86) && !defined(HUFFMAN_POSITIONS_64)
+//the kernels compare 32 bit positions, a message of 4 GiB or more holds every one of them
+inline uint32_t lastPosition(size_t size)
+{
+    return size - 1 > UINT32_MAX ? UINT32_MAX : (uint32_t)(size - 1);
+}
+
+__attribute__((target("avx2")))
+void fillPositionsAvx2(const Position* first, const Position* last, char symbol, char* out, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    const __m256i limit = _mm256_set1_epi32((int)lastPosition(size));
+    const Position* pos = first;
+    for (; last - pos >= 8; pos += 8)
+    {
+        //unsigned pos <= limit, as min(pos, limit) == pos
+        __m256i positions = _mm256_loadu_si256((const __m256i*)pos);
+        __m256i inside = _mm256_cmpeq_epi32(_mm256_min_epu32(positions, limit), positions);
+        if (_mm256_movemask_epi8(inside) == -1)
+        {
+            for (int k = 0; k < 8; k++)
+            {
+                out[pos[k]] = symbol;
+            }
+        }
+        else
+        {
+            fillPositionsPortable(pos, pos + 8, symbol, out, size);
+        }
+    }
+    fillPositionsPortable(pos, last, symbol, out, size);
+}
+
+__attribute__((target("avx512f")))
+void fillPositionsAvx512(const Position* first, const Position* last, char symbol, char* out, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    const __m512i limit = _mm512_set1_epi32((int)lastPosition(size));
+    const Position* pos = first;
+    for (; last - pos >= 16; pos += 16)
+    {
+        if (_mm512_cmple_epu32_mask(_mm512_loadu_si512(pos), limit) == 0xffff)
+        {
+            for (int k = 0; k < 16; k++)
+            {
+                out[pos[k]] = symbol;
+            }
+        }
+        else
+        {
+            fillPositionsPortable(pos, pos + 16, symbol, out, size);
+        }
+    }
+    fillPositionsPortable(pos, last, symbol, out, size);
+}
+#endif
+
+//Function to write symbol at every position of [first, last) with the kernel of the given instruction set
+void fillPositionsWith(SimdLevel level, const Position* first, const Position* last, char symbol, char* out, size_t size)
+{
+#if defined(HUFFMAN_SIMD_X86) && !defined(HUFFMAN_POSITIONS_64)
+    if (level == SIMD_AVX512)
+    {
+        fillPositionsAvx512(first, last, symbol, out, size);
+        return;
+    }
+    if (level == SIMD_AVX2)
+    {
+        fillPositionsAvx2(first, last, symbol, out, size);
+        return;
+    }
+#endif
+    fillPositionsPortable(first, last, symbol, out, size);
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Fixed-size pool of POSIX threads.
+// The threads are created once and sleep on a condition variable between jobs. A job is split into chunks that
+// workers claim with an atomic counter, so the number of threads does not depend on the size of the input.
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include "huffmanTrace.h"
+
+//number of online cores, at least 1
+int hardwareThreads()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+class ThreadPool
+{
+public:
+    //threads is the total number of threads working on a job, the caller of run() counts as one of them.
+    //If a thread cannot be created the pool works with the ones that started, at worst the caller alone.
+    ThreadPool(int threads = hardwareThreads()) : generation(0), stopping(false), chunks(0), busy(0)
+    {
+        TRACE_SCOPE("pool start");
+        pthread_mutex_init(&mutex, nullptr);
+        pthread_cond_init(&wake, nullptr);
+        pthread_cond_init(&done, nullptr);
+        for (int i = 1; i < threads; i++)
+        {
+            pthread_t thread;
+            if (pthread_create(&thread, nullptr, workerMain, this) != 0)
+            {
+                break;
+            }
+            workers.push_back(thread);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_cond_broadcast(&wake);
+        pthread_mutex_unlock(&mutex);
+        for (pthread_t& thread : workers)
+        {
+            pthread_join(thread, nullptr);
+        }
+        pthread_mutex_destroy(&mutex);
+        pthread_cond_destroy(&wake);
+        pthread_cond_destroy(&done);
+    }
+
+    //number of threads working on a job
+    int size() const
+    {
+        return workers.size() + 1;
+    }
+
+    //Run job(chunk) for every chunk in [0, count) and return once all of them are done.
+    //The calling thread works on the job too. Jobs must not be started from inside a job.
+    void run(int count, const std::function<void(int)>& work)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+        pthread_mutex_lock(&mutex);
+        job = work;
+        chunks = count;
+        next.store(0);
+        busy = workers.size();
+        generation++;
+        pthread_cond_broadcast(&wake);
+        pthread_mutex_unlock(&mutex);
+
+        drain();
+
+        //wait for the workers to leave the job before it can be replaced
+        TRACE_WAIT("pool join");
+        pthread_mutex_lock(&mutex);
+        while (busy > 0)
+        {
+            pthread_cond_wait(&done, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+
+private:
+    std::vector<pthread_t> workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; //a job was published or the pool is stopping
+    pthread_cond_t done; //a worker finished its part of the job
+    std::function<void(int)> job;
+    unsigned long generation; //incremented for every job
+    bool stopping;
+    int chunks;
+    std::atomic<int> next; //next chunk to claim
+    size_t busy;           //workers still inside the current job
+
+    //claim and run chunks until none is left
+    void drain()
+    {
+        int chunk;
+        while ((chunk = next.fetch_add(1)) < chunks)
+        {
+            job(chunk);
+        }
+    }
+
+    static void* workerMain(void* arg)
+    {
+        ThreadPool* pool = (ThreadPool*)arg;
+        unsigned long seen = 0;
+        while (true)
+        {
+            {
+                TRACE_WAIT("pool idle");
+                pthread_mutex_lock(&pool->mutex);
+                while (!pool->stopping && pool->generation == seen)
+                {
+                    pthread_cond_wait(&pool->wake, &pool->mutex);
+                }
+            }
+            if (pool->stopping)
+            {
+                pthread_mutex_unlock(&pool->mutex);
+                return nullptr;
+            }
+            seen = pool->generation;
+            pthread_mutex_unlock(&pool->mutex);
+
+            pool->drain();
+
+            pthread_mutex_lock(&pool->mutex);
+            if (--pool->busy == 0)
+            {
+                pthread_cond_signal(&pool->done);
+            }
+            pthread_mutex_unlock(&pool->mutex);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,720 @@
+// Micro and macro benchmarks of the Huffman decompressors, with results in JSON for regression tracking.
+// Every case runs on synthetic alphabets of 4, 64 and 256 symbols whose frequencies are uniform, Zipf (1/rank) or
+// skewed (every symbol half as frequent as the one before, down to 1), over a message of --size symbols:
+//   BM_BuildPointerTree  init_pq + buildHuffmanTree + deleteHuffmanTree, the node per allocation tree
+//   BM_BuildFlatTree     buildFlatHuffmanTree into a reused flat tree
+//   BM_GetChar           per bit walk of the pointer tree, one binary code string at a time
+//   BM_FlatGetChar       per bit walk of the flat tree
+//   BM_TableDecode       multi-level decode table, same codes
+//   BM_Traverse          traverse() code emission of the report line of every symbol, one tree search per symbol
+//   BM_CodeTable         the same lines from a code table built in one walk of the tree
+//   BM_BuildTables       tree, decode table and code table, what a cache miss builds
+//   BM_CacheHit          the same from the in-process cache: fingerprint and alphabet comparison
+//   BM_CacheFileHit      the same from a cache file opened and mapped by a new cache, as a new process would
+//   BM_Parse             scan of the binary code and position lines into a PositionTable
+//   BM_Histogram         byte histogram of the message as the encoder counts it, with the portable scalar loop and
+//                        the avx512 kernel of simdKernels.h when the processor has it
+//   BM_FillPositions     every symbol written at its list of positions, the scatter of one thread, with the portable,
+//                        avx2 and avx512 kernels the processor runs
+//   BM_DecompressText    parse + tree + table decode + scatter, what assignment 3 does besides printing
+//   BM_DecompressPacked  whole packed container decoded in memory, with the table or the tree
+//   BM_DecompressBlocks  the same message in 64 blocks, or more of MAX_BLOCK_SYMBOLS, interleaved on one core and on
+//                        every core of the pool
+// The u16/ cases build, decode and report with 16 bit symbols and 64 bit counts, on Zipf alphabets of 256 symbols,
+// to compare with the byte tree, and of 65536 symbols, which no byte alphabet reaches.
+// The output follows the JSON layout of Google Benchmark: a context object and a list of benchmarks with
+// iterations, real_time and cpu_time in ns per iteration, and items_per_second / bytes_per_second.
+// Build: cmake target huffman_bench, or g++ -std=c++17 -O2 -pthread -o huffman_bench bench/huffmanBench.cpp
+// Usage: ./huffman_bench [--size=N] [--min-time=SECONDS] [--filter=SUBSTRING] [--out=FILE] [--check]
+// The vector kernels of simdKernels.h are checked against the portable loops before anything is timed, --check only
+// runs that check (ctest runs it as simd_kernels).
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../Assignment 3/huffmanTree.h"
+#include "../Assignment 3/huffmanTable.h"
+#include "../Assignment 3/huffmanFlatTree.h"
+#include "../Assignment 3/huffmanStream.h"
+#include "../Assignment 3/huffmanEncode.h"
+#include "../Assignment 3/huffmanBlocks.h"
+#include "../Assignment 3/huffmanCache.h"
+#include "../Assignment 3/inputLoader.h"
+#include "../Assignment 3/positionTable.h"
+#include "../Assignment 3/scatter.h"
+#include "../Assignment 3/simdKernels.h"
+#include "../Assignment 3/threadPool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//keeps the compiler from dropping a result that is otherwise unused
+volatile char sink;
+
+struct BenchOptions
+{
+    size_t messageSize = 1 << 20;
+    double minTime = 0.2;
+    std::string filter;
+    std::string out;
+    bool check = false; //only check the vector kernels
+};
+
+struct BenchResult
+{
+    std::string name;
+    long long iterations;
+    double realNs; //per iteration
+    double cpuNs;  //per iteration, every thread of the process
+    double items;  //per iteration, 0 if not counted
+    double bytes;  //per iteration, 0 if not counted
+};
+
+//Synthetic input: an alphabet, its frequencies and a message with exactly those frequencies
+struct Workload
+{
+    std::string name;
+    std::vector<char> symbols;
+    std::vector<int> frequencies;
+    std::vector<unsigned char> message;
+};
+
+enum Distribution
+{
+    UNIFORM,
+    ZIPF,
+    SKEWED
+};
+
+const char* distributionName(Distribution distribution)
+{
+    return distribution == UNIFORM ? "uniform" : distribution == ZIPF ? "zipf" : "skewed";
+}
+
+//Workload of 16 bit symbols with 64 bit counts
+struct WideWorkload
+{
+    std::string name;
+    std::vector<uint16_t> symbols;
+    std::vector<uint64_t> frequencies;
+    std::vector<uint16_t> message;
+};
+
+//Frequencies of alphabet symbols summing to size, every symbol at least once
+std::vector<int> workloadFrequencies(int alphabet, Distribution distribution, size_t size)
+{
+    std::vector<double> weight(alphabet);
+    for (int i = 0; i < alphabet; i++)
+    {
+        weight[i] = distribution == UNIFORM ? 1.0 : distribution == ZIPF ? 1.0 / (i + 1) : std::ldexp(1.0, -std::min(i, 60));
+    }
+    double total = 0;
+    for (double w : weight)
+    {
+        total += w;
+    }
+    std::vector<int> frequencies;
+    long long assigned = 0;
+    for (int i = 0; i < alphabet; i++)
+    {
+        frequencies.push_back(std::max(1, (int)(weight[i] / total * (size - alphabet))));
+        assigned += frequencies[i];
+    }
+    frequencies[0] += size - assigned; //the rounding goes to the most frequent symbol
+    return frequencies;
+}
+
+//Frequencies of alphabet symbols summing to size and a shuffled message using them
+Workload makeWorkload(int alphabet, Distribution distribution, size_t size)
+{
+    Workload work;
+    work.name = std::to_string(alphabet) + "/" + distributionName(distribution);
+    work.frequencies = workloadFrequencies(alphabet, distribution, size);
+    for (int i = 0; i < alphabet; i++)
+    {
+        work.symbols.push_back((char)i);
+        work.message.insert(work.message.end(), work.frequencies[i], (unsigned char)i);
+    }
+    std::mt19937 random(alphabet * 3 + distribution);
+    std::shuffle(work.message.begin(), work.message.end(), random);
+    return work;
+}
+
+//makeWorkload with 16 bit symbols, for alphabets up to 65536 symbols
+WideWorkload makeWideWorkload(int alphabet, Distribution distribution, size_t size)
+{
+    WideWorkload work;
+    work.name = "u16/" + std::to_string(alphabet) + "/" + distributionName(distribution);
+    std::vector<int> frequencies = workloadFrequencies(alphabet, distribution, std::max(size, (size_t)alphabet));
+    for (int i = 0; i < alphabet; i++)
+    {
+        work.symbols.push_back((uint16_t)i);
+        work.frequencies.push_back(frequencies[i]);
+        work.message.insert(work.message.end(), frequencies[i], (uint16_t)i);
+    }
+    std::mt19937 random(alphabet * 3 + distribution);
+    std::shuffle(work.message.begin(), work.message.end(), random);
+    return work;
+}
+
+//CPU time of the whole process, every thread included
+double processCpuNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+class BenchRunner
+{
+public:
+    BenchRunner(const BenchOptions& benchOptions) : options(benchOptions) {}
+
+    //Run body until one round of iterations takes at least the minimum time, growing the count between rounds.
+    //items and bytes are what one iteration processes, for the throughput columns.
+    void run(const std::string& name, double items, double bytes, const std::function<void()>& body)
+    {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+        {
+            return;
+        }
+        body(); //warm up the caches and the allocator
+        long long iterations = 1;
+        while (true)
+        {
+            Clock::time_point start = Clock::now();
+            double cpuStart = processCpuNs();
+            for (long long i = 0; i < iterations; i++)
+            {
+                body();
+            }
+            double cpu = processCpuNs() - cpuStart;
+            double real = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if (real >= options.minTime * 1e9 || iterations >= (1ll << 30))
+            {
+                results.push_back({name, iterations, real / iterations, cpu / iterations, items, bytes});
+                fprintf(stderr, "%-44s %12.0f ns %12lld iterations\n", name.c_str(), real / iterations, iterations);
+                return;
+            }
+            //aim a little past the minimum time from what this round took
+            double scale = real > 0 ? options.minTime * 1.2e9 / real : 10;
+            iterations = (long long)(iterations * std::min(std::max(scale, 2.0), 100.0));
+        }
+    }
+
+    void writeJson(FILE* out, int threads) const
+    {
+        char date[64];
+        time_t now = time(nullptr);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        fprintf(out, "{\n  \"context\": {\n");
+        fprintf(out, "    \"date\": \"%s\",\n", date);
+        fprintf(out, "    \"num_cpus\": %d,\n", threads);
+        fprintf(out, "    \"simd\": \"%s\",\n", simdLevelName(simdLevel()));
+        fprintf(out, "    \"message_size\": %zu,\n", options.messageSize);
+        fprintf(out, "    \"min_time\": %g\n  },\n", options.minTime);
+        fprintf(out, "  \"benchmarks\": [\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult& r = results[i];
+            fprintf(out, "    {\n      \"name\": \"%s\",\n      \"iterations\": %lld,\n", r.name.c_str(), r.iterations);
+            fprintf(out, "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\"", r.realNs, r.cpuNs);
+            if (r.items > 0)
+            {
+                fprintf(out, ",\n      \"items_per_second\": %.6e", r.items * 1e9 / r.realNs);
+            }
+            if (r.bytes > 0)
+            {
+                fprintf(out, ",\n      \"bytes_per_second\": %.6e", r.bytes * 1e9 / r.realNs);
+            }
+            fprintf(out, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    BenchOptions options;
+    std::vector<BenchResult> results;
+};
+
+//binary code of every symbol as '0'/'1' characters, from the flat tree
+template <typename Tree>
+std::vector<std::string> binaryCodes(const Tree& tree, int alphabet)
+{
+    std::vector<SymbolCode> codes;
+    flatTreeCodes(tree, codes);
+    std::vector<std::string> text(alphabet);
+    for (const SymbolCode& code : codes)
+    {
+        std::string& bits = text[code.symbol];
+        for (int b = code.length - 1; b >= 0; b--)
+        {
+            bits += (char)('0' + ((code.bits >> b) & 1));
+        }
+    }
+    return text;
+}
+
+//the binary code and position lines of the assignment 3 text format, without the alphabet lines
+std::string positionLines(const Workload& work, const std::vector<std::string>& codes)
+{
+    std::vector<std::vector<uint32_t>> positions(work.symbols.size());
+    for (size_t i = 0; i < work.message.size(); i++)
+    {
+        positions[work.message[i]].push_back(i);
+    }
+    std::string text;
+    for (size_t s = 0; s < work.symbols.size(); s++)
+    {
+        text += codes[s];
+        for (uint32_t position : positions[s])
+        {
+            text += ' ';
+            text += std::to_string(position);
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+//packed container of the message, as written by compress
+std::string packedContainer(const Workload& work, const FlatHuffmanTree& tree)
+{
+    HuffmanCodeTable codes;
+    buildCodeTable(tree, codes);
+    std::ostringstream out;
+    BitWriter writer(out);
+    writeStreamHeader(writer, work.symbols, work.frequencies, work.message.size());
+    encodePayload(writer, codes, work.message.data(), work.message.size());
+    writer.flush();
+    return out.str();
+}
+
+//blocked packed container of the message in blocks blocks, as written by compress --blocks
+std::string blockedContainer(const Workload& work, const FlatHuffmanTree& tree, size_t blocks)
+{
+    HuffmanCodeTable codes;
+    buildCodeTable(tree, codes);
+    std::ostringstream out;
+    size_t blockSymbols = (work.message.size() + blocks - 1) / blocks;
+    blockSymbols = blockSymbols < MAX_BLOCK_SYMBOLS ? blockSymbols : MAX_BLOCK_SYMBOLS;
+    writeBlockedStream(out, work.symbols, work.frequencies, codes, work.message.data(), work.message.size(), blockSymbols);
+    return out.str();
+}
+
+//parse position lines the way assignment 3 does
+void parsePositionLines(const std::string& text, int alphabet, size_t total, std::vector<std::string>& codes, PositionTable& positions)
+{
+    InputScanner scanner(text.data(), text.size());
+    positions = PositionTable();
+    positions.reserve(alphabet, total);
+    for (int i = 0; i < alphabet; i++)
+    {
+        scanner.readToken(codes[i]);
+        scanner.readInts(positions);
+        positions.endRow();
+        scanner.nextLine();
+    }
+}
+
+void benchWorkload(BenchRunner& runner, ThreadPool& pool, ThreadPool& single, Workload& work)
+{
+    int alphabet = work.symbols.size();
+    size_t size = work.message.size();
+
+    runner.run("BM_BuildPointerTree/" + work.name, alphabet, 0, [&]() {
+        priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq;
+        int nodeCounter = 0;
+        init_pq(work.symbols.data(), work.frequencies.data(), alphabet, pq, nodeCounter);
+        HuffmanTreeNode* root = buildHuffmanTree(pq, nodeCounter);
+        sink = root->character;
+        deleteHuffmanTree(root);
+    });
+
+    FlatHuffmanTree tree;
+    runner.run("BM_BuildFlatTree/" + work.name, alphabet, 0, [&]() {
+        buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, tree);
+        sink = tree.nodes[tree.root].character;
+    });
+    buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, tree);
+    HuffmanDecodeTable table = buildDecodeTable(tree);
+    std::vector<std::string> codes = binaryCodes(tree, alphabet);
+
+    //the codes of the first symbols of the message, in message order
+    const size_t sampleSize = std::min<size_t>(size, 1 << 14);
+    std::vector<std::string> sample;
+    size_t sampleBits = 0;
+    for (size_t i = 0; i < sampleSize; i++)
+    {
+        sample.push_back(codes[work.message[i]]);
+        sampleBits += sample.back().size();
+    }
+
+    priority_queue<HuffmanTreeNode*, vector<HuffmanTreeNode*>, Compare> pq;
+    int nodeCounter = 0;
+    init_pq(work.symbols.data(), work.frequencies.data(), alphabet, pq, nodeCounter);
+    HuffmanTreeNode* root = buildHuffmanTree(pq, nodeCounter);
+    runner.run("BM_GetChar/" + work.name, sampleSize, sampleBits / 8.0, [&]() {
+        for (const std::string& code : sample)
+        {
+            sink = getChar(root, code);
+        }
+    });
+    deleteHuffmanTree(root);
+    runner.run("BM_FlatGetChar/" + work.name, sampleSize, sampleBits / 8.0, [&]() {
+        for (const std::string& code : sample)
+        {
+            sink = getChar(tree, code);
+        }
+    });
+    runner.run("BM_TableDecode/" + work.name, sampleSize, sampleBits / 8.0, [&]() {
+        for (const std::string& code : sample)
+        {
+            sink = decodeTableChar(table, code);
+        }
+    });
+
+    runner.run("BM_Traverse/" + work.name, alphabet, 0, [&]() {
+        std::ostringstream lines;
+        int arr[100];
+        for (char symbol : work.symbols)
+        {
+            traverse(tree, tree.root, symbol, arr, 0, lines);
+        }
+        sink = lines.str().size();
+    });
+
+    runner.run("BM_CodeTable/" + work.name, alphabet, 0, [&]() {
+        FlatCodeTable table;
+        buildFlatCodeTable(tree, table);
+        std::string lines;
+        for (char symbol : work.symbols)
+        {
+            appendCodeLine(lines, tree, table, table.leafOf[symbol]);
+        }
+        sink = lines.size();
+    });
+
+    runner.run("BM_BuildTables/" + work.name, alphabet, 0, [&]() {
+        FlatHuffmanTree built;
+        buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, built);
+        HuffmanDecodeTable builtTable = buildDecodeTable(built);
+        FlatCodeTable builtCodes;
+        buildFlatCodeTable(built, builtCodes);
+        sink = builtTable.maxLength + builtCodes.codes.size();
+    });
+    HuffmanCache<char, int> cache;
+    cache.lookup(work.symbols.data(), work.frequencies.data(), alphabet);
+    runner.run("BM_CacheHit/" + work.name, alphabet, 0, [&]() {
+        sink = cache.lookup(work.symbols.data(), work.frequencies.data(), alphabet).table.maxLength;
+    });
+    std::string cachePath = "/tmp/huffman_bench_cache_" + std::to_string(getpid()) + ".bin";
+    {
+        HuffmanCache<char, int> writer;
+        writer.open(cachePath.c_str());
+        writer.lookup(work.symbols.data(), work.frequencies.data(), alphabet);
+    }
+    runner.run("BM_CacheFileHit/" + work.name, alphabet, 0, [&]() {
+        HuffmanCache<char, int> reader;
+        reader.open(cachePath.c_str());
+        sink = reader.lookup(work.symbols.data(), work.frequencies.data(), alphabet).table.maxLength;
+    });
+    unlink(cachePath.c_str());
+
+    std::string text = positionLines(work, codes);
+    std::vector<std::string> parsedCodes(alphabet);
+    PositionTable positions;
+    runner.run("BM_Parse/" + work.name, size, text.size(), [&]() {
+        parsePositionLines(text, alphabet, size, parsedCodes, positions);
+        sink = positions.total();
+    });
+
+    std::vector<char> message(size);
+    parsePositionLines(text, alphabet, size, parsedCodes, positions); //BM_Parse may have been filtered out
+    for (int level = SIMD_PORTABLE; level <= simdLevel(); level++)
+    {
+        SimdLevel kernel = (SimdLevel)level;
+        if (kernel != SIMD_AVX2) //no histogram kernel of its own
+        {
+            runner.run(std::string("BM_Histogram/") + simdLevelName(kernel) + "/" + work.name, size, size, [&]() {
+                uint64_t counts[256];
+                countFrequenciesWith(kernel, work.message.data(), size, counts);
+                sink = (char)counts[0];
+            });
+        }
+        runner.run(std::string("BM_FillPositions/") + simdLevelName(kernel) + "/" + work.name, size, 0, [&]() {
+            for (size_t i = 0; i < positions.rows(); i++)
+            {
+                fillPositionsWith(kernel, positions[i].begin(), positions[i].end(), work.symbols[i], message.data(), size);
+            }
+            sink = message[size - 1];
+        });
+    }
+
+    runner.run("BM_DecompressText/" + work.name, size, text.size(), [&]() {
+        parsePositionLines(text, alphabet, size, parsedCodes, positions);
+        FlatHuffmanTree decodeTree;
+        buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, decodeTree);
+        HuffmanDecodeTable decodeTable = buildDecodeTable(decodeTree);
+        std::vector<char> symbols(alphabet);
+        for (int i = 0; i < alphabet; i++)
+        {
+            symbols[i] = decodeTableChar(decodeTable, parsedCodes[i]);
+        }
+        scatterPositions(pool, symbols, positions, message.data(), size);
+        sink = message[size - 1];
+    });
+
+    std::string container = packedContainer(work, tree);
+    const DecodeMode modes[2] = {DECODE_TABLE, DECODE_TREE};
+    for (DecodeMode mode : modes)
+    {
+        std::string name = std::string("BM_DecompressPacked/") + (mode == DECODE_TABLE ? "table/" : "tree/") + work.name;
+        runner.run(name, size, container.size(), [&]() {
+            MemoryStreamBuffer buffer(container.data(), container.size());
+            std::istream in(&buffer);
+            BitReader reader(in);
+            StreamHeader header;
+            StreamCodec codec;
+            if (readStreamHeader(reader, header) && prepareStreamCodec(header, codec))
+            {
+                decodeStream(reader, codec, mode, message.data(), header.messageLength);
+            }
+            sink = message[size - 1];
+        });
+    }
+
+    std::string blocked = blockedContainer(work, tree, 64);
+    ThreadPool* pools[2] = {&single, &pool};
+    const char* poolNames[2] = {"single", "pool"};
+    for (int p = 0; p < 2; p++)
+    {
+        ThreadPool* decoders = pools[p];
+        std::string name = std::string("BM_DecompressBlocks/") + poolNames[p] + "/" + work.name;
+        runner.run(name, size, blocked.size(), [&]() {
+            MemoryStreamBuffer buffer(blocked.data(), blocked.size());
+            std::istream in(&buffer);
+            BitReader reader(in);
+            StreamHeader header;
+            StreamCodec codec;
+            std::vector<uint64_t> blockOffset;
+            if (readStreamHeader(reader, header) && prepareStreamCodec(header, codec))
+            {
+                size_t offset = reader.offset();
+                if (blockOffsets(header, blocked.size() - offset, blockOffset))
+                {
+                    decodeBlockRange(*decoders, header, codec, DECODE_TABLE, (const unsigned char*)blocked.data() + offset, blockOffset, 0, header.blockBytes.size(), message.data());
+                }
+            }
+            sink = message[size - 1];
+        });
+    }
+}
+
+//tree build, decode and report line cases with 16 bit symbols and 64 bit counts
+void benchWideWorkload(BenchRunner& runner, WideWorkload& work)
+{
+    int alphabet = work.symbols.size();
+    BasicFlatHuffmanTree<uint16_t, uint64_t> tree;
+    runner.run("BM_BuildFlatTree/" + work.name, alphabet, 0, [&]() {
+        buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, tree);
+        sink = (char)tree.nodes[tree.root].frequency;
+    });
+    buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, tree);
+    HuffmanDecodeTable table = buildDecodeTable(tree);
+    std::vector<std::string> codes = binaryCodes(tree, alphabet);
+
+    const size_t sampleSize = std::min<size_t>(work.message.size(), 1 << 14);
+    std::vector<std::string> sample;
+    size_t sampleBits = 0;
+    for (size_t i = 0; i < sampleSize; i++)
+    {
+        sample.push_back(codes[work.message[i]]);
+        sampleBits += sample.back().size();
+    }
+    runner.run("BM_FlatGetChar/" + work.name, sampleSize, sampleBits / 8.0, [&]() {
+        for (const std::string& code : sample)
+        {
+            sink = (char)getChar(tree, code);
+        }
+    });
+    runner.run("BM_TableDecode/" + work.name, sampleSize, sampleBits / 8.0, [&]() {
+        for (const std::string& code : sample)
+        {
+            sink = (char)decodeTableSymbol(table, code);
+        }
+    });
+
+    runner.run("BM_CodeTable/" + work.name, alphabet, 0, [&]() {
+        BasicFlatCodeTable<uint16_t> codeTable;
+        buildFlatCodeTable(tree, codeTable);
+        std::string lines;
+        for (uint16_t symbol : work.symbols)
+        {
+            appendCodeLine(lines, tree, codeTable, codeTable.leafOf[symbol]);
+        }
+        sink = lines.size();
+    });
+
+    runner.run("BM_BuildTables/" + work.name, alphabet, 0, [&]() {
+        BasicFlatHuffmanTree<uint16_t, uint64_t> built;
+        buildFlatHuffmanTree(work.symbols.data(), work.frequencies.data(), alphabet, built);
+        HuffmanDecodeTable builtTable = buildDecodeTable(built);
+        BasicFlatCodeTable<uint16_t> builtCodes;
+        buildFlatCodeTable(built, builtCodes);
+        sink = builtTable.maxLength + builtCodes.codes.size();
+    });
+    std::string cachePath = "/tmp/huffman_bench_cache_" + std::to_string(getpid()) + ".bin";
+    {
+        HuffmanCache<uint16_t, uint64_t> writer;
+        writer.open(cachePath.c_str());
+        writer.lookup(work.symbols.data(), work.frequencies.data(), alphabet);
+    }
+    runner.run("BM_CacheFileHit/" + work.name, alphabet, 0, [&]() {
+        HuffmanCache<uint16_t, uint64_t> reader;
+        reader.open(cachePath.c_str());
+        sink = reader.lookup(work.symbols.data(), work.frequencies.data(), alphabet).table.maxLength;
+    });
+    unlink(cachePath.c_str());
+}
+
+BenchOptions parseBenchOptions(int argc, char* argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--size=", 7) == 0)
+        {
+            options.messageSize = std::max(256ll, atoll(argv[i] + 7));
+        }
+        else if (strncmp(argv[i], "--min-time=", 11) == 0)
+        {
+            options.minTime = atof(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--filter=", 9) == 0)
+        {
+            options.filter = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--out=", 6) == 0)
+        {
+            options.out = argv[i] + 6;
+        }
+        else if (strcmp(argv[i], "--check") == 0)
+        {
+            options.check = true;
+        }
+    }
+    return options;
+}
+
+//Function to check every vector kernel the processor runs against the portable loop, on sizes around the vector
+//widths, inputs whose bytes all hit the same counters and positions past the end of the message.
+//False with a message on the first difference.
+bool checkSimdKernels()
+{
+    std::mt19937 generator(3360);
+    const size_t sizes[] = {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, (1 << 16) + 5};
+    for (int level = SIMD_PORTABLE + 1; level <= simdLevel(); level++)
+    {
+        SimdLevel kernel = (SimdLevel)level;
+        for (size_t size : sizes)
+        {
+            //random bytes, one repeated byte and two alternating bytes
+            for (int pattern = 0; pattern < 3; pattern++)
+            {
+                std::vector<unsigned char> data(size);
+                for (size_t i = 0; i < size; i++)
+                {
+                    data[i] = pattern == 0 ? generator() : pattern == 1 ? 'a' : (i & 1) * 255;
+                }
+                uint64_t expected[256];
+                uint64_t counts[256];
+                countFrequenciesPortable(data.data(), size, expected);
+                countFrequenciesWith(kernel, data.data(), size, counts);
+                if (memcmp(expected, counts, sizeof(counts)) != 0)
+                {
+                    fprintf(stderr, "Error: the %s histogram differs from the portable one on %zu bytes\n", simdLevelName(kernel), size);
+                    return false;
+                }
+            }
+
+            //a quarter of the positions are past the end of the message and have to be ignored
+            std::vector<Position> positions(size);
+            for (size_t i = 0; i < size; i++)
+            {
+                positions[i] = generator() % 4 == 0 ? (Position)(size + generator() % 3) : (Position)(generator() % size);
+            }
+            if (size > 0)
+            {
+                positions[size / 2] = std::numeric_limits<Position>::max();
+            }
+            std::vector<char> expected(size, '.');
+            std::vector<char> message(size, '.');
+            fillPositionsPortable(positions.data(), positions.data() + size, 'x', expected.data(), size);
+            fillPositionsWith(kernel, positions.data(), positions.data() + size, 'x', message.data(), size);
+            if (expected != message)
+            {
+                fprintf(stderr, "Error: the %s position fill differs from the portable one on %zu positions\n", simdLevelName(kernel), size);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options = parseBenchOptions(argc, argv);
+    //the timings of a kernel that computes something else would mean nothing
+    if (!checkSimdKernels())
+    {
+        return 1;
+    }
+    if (options.check)
+    {
+        printf("vector kernels up to %s match the portable loops\n", simdLevelName(simdLevel()));
+        return 0;
+    }
+    BenchRunner runner(options);
+    ThreadPool pool;
+    ThreadPool single(1);
+
+    const int alphabets[3] = {4, 64, 256};
+    const Distribution distributions[3] = {UNIFORM, ZIPF, SKEWED};
+    for (int alphabet : alphabets)
+    {
+        for (Distribution distribution : distributions)
+        {
+            Workload work = makeWorkload(alphabet, distribution, options.messageSize);
+            benchWorkload(runner, pool, single, work);
+        }
+    }
+    const int wideAlphabets[2] = {256, 65536};
+    for (int alphabet : wideAlphabets)
+    {
+        WideWorkload work = makeWideWorkload(alphabet, ZIPF, options.messageSize);
+        benchWideWorkload(runner, work);
+    }
+
+    FILE* out = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+    if (!out)
+    {
+        fprintf(stderr, "Error: could not open %s\n", options.out.c_str());
+        return 1;
+    }
+    runner.writeJson(out, pool.size());
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Latency of ordered result publication as the alphabet grows.
+// Compares the mutex/condition variable baton that assignment 3 used to print its report lines in order with the
+// ready flags of OrderedPublisher. Both run the same per-symbol work on the same ThreadPool; the latency of a line
+// is the time between its result being computed and the line being written.
+// Build: g++ -std=c++17 -O2 -pthread -o orderedPublishBench bench/orderedPublishBench.cpp
+// Usage: ./orderedPublishBench [threads]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "../Assignment 3/threadPool.h"
+#include "../Assignment 3/orderedPublisher.h"
+
+typedef std::chrono::steady_clock Clock;
+
+//stand-in for decoding a symbol and formatting its report line, the work varies a little between symbols
+std::string work(int symbol)
+{
+    unsigned value = symbol * 2654435761u;
+    int rounds = 50 + (value >> 24) % 100;
+    for (int i = 0; i < rounds; i++)
+    {
+        value = value * 1103515245u + 12345u;
+    }
+    return "Symbol: " + std::to_string(symbol) + ", Frequency: " + std::to_string(value & 0xffff) + ", Code: 0101\n";
+}
+
+struct Result
+{
+    double wallMs;
+    double meanUs;
+    double maxUs;
+};
+
+//latency statistics from the time every line was computed and written
+Result summarize(Clock::time_point start, const std::vector<Clock::time_point>& computed, const std::vector<Clock::time_point>& written)
+{
+    Result result = {0, 0, 0};
+    Clock::time_point end = start;
+    for (size_t i = 0; i < computed.size(); i++)
+    {
+        double us = std::chrono::duration<double, std::micro>(written[i] - computed[i]).count();
+        result.meanUs += us;
+        result.maxUs = std::max(result.maxUs, us);
+        end = std::max(end, written[i]);
+    }
+    result.meanUs /= computed.size();
+    result.wallMs = std::chrono::duration<double, std::milli>(end - start).count();
+    return result;
+}
+
+//every symbol waits under a mutex until it is its turn to print
+Result runBaton(ThreadPool& pool, int n)
+{
+    std::vector<Clock::time_point> computed(n), written(n);
+    std::ostringstream out;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t turn = PTHREAD_COND_INITIALIZER;
+    int current = 0;
+
+    Clock::time_point start = Clock::now();
+    pool.run(n, [&](int symbol) {
+        std::string line = work(symbol);
+        computed[symbol] = Clock::now();
+        pthread_mutex_lock(&mutex);
+        while (current != symbol)
+        {
+            pthread_cond_wait(&turn, &mutex);
+        }
+        out << line;
+        written[symbol] = Clock::now();
+        current++;
+        pthread_cond_broadcast(&turn); //a signal could wake a thread whose turn it is not
+        pthread_mutex_unlock(&mutex);
+    });
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&turn);
+    return summarize(start, computed, written);
+}
+
+//every symbol publishes its line, the calling thread writes the ready lines in order
+Result runReadyFlags(ThreadPool& pool, OrderedPublisher& publisher, int n)
+{
+    std::vector<Clock::time_point> computed(n), written(n);
+    std::ostringstream out;
+    pthread_t consumer = pthread_self();
+    size_t emitted = 0;
+    auto emit = [&]() {
+        size_t count = publisher.emit(out);
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            written[emitted++] = now;
+        }
+    };
+
+    Clock::time_point start = Clock::now();
+    publisher.reset(n);
+    pool.run(n, [&](int symbol) {
+        std::string line = work(symbol);
+        computed[symbol] = Clock::now();
+        publisher.publish(symbol, std::move(line));
+        if (pthread_equal(pthread_self(), consumer))
+        {
+            emit();
+        }
+    });
+    emit();
+    return summarize(start, computed, written);
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : hardwareThreads();
+    ThreadPool pool(threads);
+    OrderedPublisher publisher;
+    printf("threads %d\n", pool.size());
+    printf("%8s %-12s %10s %14s %14s\n", "symbols", "method", "wall ms", "mean lat us", "max lat us");
+    for (int n = 4; n <= 65536; n *= 4)
+    {
+        //best of a few runs, the first one also warms up the pool
+        Result baton = {1e30, 0, 0}, flags = {1e30, 0, 0};
+        for (int rep = 0; rep < 5; rep++)
+        {
+            Result b = runBaton(pool, n);
+            Result f = runReadyFlags(pool, publisher, n);
+            baton = b.wallMs < baton.wallMs ? b : baton;
+            flags = f.wallMs < flags.wallMs ? f : flags;
+        }
+        printf("%8d %-12s %10.3f %14.2f %14.2f\n", n, "baton", baton.wallMs, baton.meanUs, baton.maxUs);
+        printf("%8d %-12s %10.3f %14.2f %14.2f\n", n, "ready-flags", flags.wallMs, flags.meanUs, flags.maxUs);
+    }
+    return 0;
+}